@@ -0,0 +1,50 @@
+/*
+ * Project Name: Firestarter
+ * Copyright (c) 2025 Henrik Olsson
+ *
+ * Permission is hereby granted under MIT license.
+ */
+
+#ifndef __BINARY_PARSER_H__
+#define __BINARY_PARSER_H__
+
+#include "firestarter.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A binary command is BIN_CMD_START, a bin_command_t and a CRC-16 (MSB first) over the struct
+#define BIN_CMD_START '@'
+#define BIN_CMD_VERSION 1
+
+    // Fixed layout, multi byte fields are little endian
+    typedef struct __attribute__((packed)) bin_command {
+        uint8_t version;      // BIN_CMD_VERSION
+        uint8_t cmd;          // CMD_*
+        uint32_t flags;       // FLAG_*
+        uint8_t mem_type;
+        uint8_t pins;
+        uint32_t mem_size;
+        uint32_t address;
+        uint16_t vpp_mv;
+        uint32_t pulse_delay;
+        uint16_t chip_id;
+        uint8_t window;
+        uint8_t rw_line;      // 0xFF when not used
+        uint8_t vpp_line;     // 0xFF when not used
+        uint8_t bus_size;     // Number of entries in address_lines, 0 for the default bus
+        uint8_t address_lines[ADDRESS_LINES_SIZE];
+        uint16_t chunk_size;  // Requested chunk size, 0 for the default
+        uint16_t resume_crc;  // CRC-16 of the part below address with FLAG_RESUME
+        uint16_t access_ns;   // Read access time, 0 for the default
+    } bin_command_t;
+
+#define BIN_CMD_SIZE (1 + sizeof(bin_command_t) + 2)
+
+    int binary_parse(const char* buffer, size_t size, firestarter_handle_t* handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __BINARY_PARSER_H__
@@ -0,0 +1,27 @@
+/*
+ * Project Name: Firestarter
+ * Copyright (c) 2025 Henrik Olsson
+ *
+ * Permission is hereby granted under MIT license.
+ */
+
+#ifndef __CRC16_H__
+#define __CRC16_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRC16_INIT 0xFFFF
+
+    // Updates a CRC-16/CCITT-FALSE with len bytes of data, start with CRC16_INIT.
+    uint16_t crc16_update(uint16_t crc, const void* data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CRC16_H__
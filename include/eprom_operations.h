@@ -11,6 +11,7 @@ extern "C" {
     bool eprom_erase(firestarter_handle_t* handle);
     bool eprom_check_chip_id(firestarter_handle_t* handle);
     bool eprom_blank_check(firestarter_handle_t* handle);
+    bool eprom_calibrate(firestarter_handle_t* handle);
 
 #ifdef __cplusplus
 }
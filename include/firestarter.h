@@ -18,10 +18,44 @@
 #ifndef DATA_BUFFER_SIZE
 #define DATA_BUFFER_SIZE 512
 #endif
+
+// Receive and transmit rings of the firmware UART driver, powers of two up to 256
+#ifndef RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE 256
+#endif
+#ifndef TX_BUFFER_SIZE
+#define TX_BUFFER_SIZE 64
+#endif
 #define RESPONSE_MSG_SIZE 96
 
+#ifndef SERIAL_ON_IO
+// The link doesn't share pins with the data bus. In windowed mode the next chunk is
+// received into the upper half of the data buffer while the lower half is programmed.
+#define DOUBLE_BUFFERING
+#endif
+
+// Maximum number of chunks in flight in windowed mode
+#ifndef WINDOW_SIZE_MAX
+#define WINDOW_SIZE_MAX 4
+#endif
+
 #define TIMEOUT_MS 1000
 
+// Time the host has to confirm a new baud rate before the old one is restored
+#ifndef BAUD_CONFIRM_MS
+#define BAUD_CONFIRM_MS 500
+#endif
+
+// Idle time after which a negotiated baud rate falls back to MONITOR_SPEED
+#ifndef BAUD_IDLE_REVERT_MS
+#define BAUD_IDLE_REVERT_MS 30000
+#endif
+
+// Times a corrupted data packet is sent again before the command fails
+#ifndef MAX_RETRANSMITS
+#define MAX_RETRANSMITS 5
+#endif
+
 #define CMD_IDLE 0
 #define CMD_READ 1
 #define CMD_WRITE 2
@@ -34,12 +68,16 @@
 #define CMD_DEV_ADDRESS 7
 #define CMD_DEV_REGISTER 8
 #endif
+#define CMD_CALIBRATE 9
 
 #define CMD_READ_VPP 11
 #define CMD_READ_VPE 12
 #define CMD_FW_VERSION 13
 #define CMD_CONFIG 14
 #define CMD_HW_VERSION 15
+#define CMD_BAUD 16
+#define CMD_BENCHMARK 17
+#define CMD_CAPABILITIES 18
 
 #define RESPONSE_CODE_OK 1
 #define RESPONSE_CODE_DATA 3
@@ -58,6 +96,47 @@
 
 #define FLAG_VERBOSE 0x80
 
+// Run INIT, MAIN and END back to back without waiting for host ACKs
+#define FLAG_AUTO_ADVANCE 0x100
+
+// Data packets carry a sequence number and a CRC-16, bad packets are sent again
+#define FLAG_CRC 0x200
+
+// All output is sent as typed SLIP frames instead of text lines
+#define FLAG_FRAMED 0x400
+
+// Continue an interrupted write at "address", the part below it is confirmed with "resume-crc"
+#define FLAG_RESUME 0x800
+
+// Protocol features reported by CMD_CAPABILITIES
+#define CAP_BINARY_CMD 0x01
+#define CAP_WINDOW 0x02
+#define CAP_STREAM_READ 0x04
+#define CAP_AUTO_ADVANCE 0x08
+#define CAP_CRC 0x10
+#define CAP_FRAMED 0x20
+#define CAP_BAUD 0x40
+#define CAP_BENCHMARK 0x80
+#define CAP_CHUNK_SIZE 0x100
+#define CAP_RESUME 0x200
+#define CAP_DOUBLE_BUFFERING 0x400
+#define CAP_ACCESS_TIME 0x800
+#define CAP_CALIBRATE 0x1000
+
+#define CAP_COMMON                                                                                      \
+    (CAP_BINARY_CMD | CAP_WINDOW | CAP_STREAM_READ | CAP_AUTO_ADVANCE | CAP_CRC | CAP_FRAMED | CAP_BAUD | \
+     CAP_BENCHMARK | CAP_CHUNK_SIZE | CAP_RESUME | CAP_ACCESS_TIME | \
+     CAP_CALIBRATE)
+#ifdef DOUBLE_BUFFERING
+#define CAPABILITIES (CAP_COMMON | CAP_DOUBLE_BUFFERING)
+#else
+#define CAPABILITIES CAP_COMMON
+#endif
+
+// Checksums and compression codecs reported by CMD_CAPABILITIES
+#define CHECKSUM_CRC16_CCITT 0x01
+#define CODECS 0x00
+
 #define is_flag_set(flag) \
     ((handle->ctrl_flags & flag) == flag)
 
@@ -71,6 +150,15 @@ typedef struct bus_config {
     uint8_t vpp_line;                           // VPP line mapping
 } bus_config_t;
 
+typedef struct transfer_window {
+    uint8_t size;        // Granted chunks in flight, 0 for stop-and-wait
+    uint8_t credit;      // Chunks the firmware may still send before the host ACKs
+    uint8_t ack_chunks;  // Chunks covered by one host ACK when reading
+    uint16_t seq;        // Number of completed chunks, sent as cumulative ACK
+    uint8_t retries;     // Retransmissions of the current chunk
+    uint32_t start;      // Address of the first chunk, used to go back on a resend
+} transfer_window_t;
+
 typedef struct firestarter_handle {
     uint8_t cmd;
     uint8_t operation_state;
@@ -83,11 +171,15 @@ typedef struct firestarter_handle {
     uint32_t address;
     uint16_t vpp_mv;
     uint32_t pulse_delay;
+    uint16_t access_ns;
     uint32_t ctrl_flags;
     uint16_t chip_id;
+    uint16_t resume_crc;
     char data_buffer[DATA_BUFFER_SIZE];
     uint32_t data_size;
+    uint16_t chunk_size;
     bus_config_t bus_config;
+    transfer_window_t window;
     void* progress_data;
 
     void (*firestarter_operation_init)(struct firestarter_handle*);
@@ -9,8 +9,11 @@ extern "C" {
     bool hw_read_voltage(firestarter_handle_t* handle);
     bool hw_get_version(firestarter_handle_t* handle);
     bool hw_get_config(firestarter_handle_t* handle);
+    bool hw_set_baud(firestarter_handle_t* handle, unsigned long baud);
+    bool hw_benchmark(firestarter_handle_t* handle);
 
     bool fw_get_version(firestarter_handle_t* handle);
+    bool fw_get_capabilities(firestarter_handle_t* handle);
 #ifdef __cplusplus
 }
 #endif
@@ -20,6 +20,7 @@ extern "C" {
     uint8_t json_get_cmd(const char* json, jsmntok_t* tokens, int token_count, firestarter_handle_t* handle);
     int json_parse(const char* json, jsmntok_t* tokens, int token_count, firestarter_handle_t* handle);
     int json_parse_config(const char* json, jsmntok_t* tokens, int token_count, rurp_configuration_t* config, firestarter_handle_t* handle);
+    int json_parse_baud(const char* json, jsmntok_t* tokens, int token_count, unsigned long* baud, firestarter_handle_t* handle);
 
 #ifdef __cplusplus
 }
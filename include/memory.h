@@ -9,6 +9,30 @@
 #define __MEMORY_H__
 #include "firestarter.h"
 
+// Bytes checked between progress messages, unless the host asks for a chunk size
+#define BLANK_CHECK_CHUNK_SIZE 2048
+
+// Wait between setting the address and reading the data, unless the command has "access-ns"
+#ifndef ACCESS_NS_DEFAULT
+#define ACCESS_NS_DEFAULT 3000
+#endif
+
+// Reads of the sample at each access time during calibration, and the margin added to the result
+#ifndef CALIBRATE_PASSES
+#define CALIBRATE_PASSES 8
+#endif
+#ifndef CALIBRATE_MARGIN_NS
+#define CALIBRATE_MARGIN_NS 250
+#endif
+
+#define TYPE_EPROM 1
+#define TYPE_FLASH_TYPE_2 2
+#define TYPE_FLASH_TYPE_3 3
+#define TYPE_SRAM 4
+
+// Bit per memory type that configure_memory can set up
+#define MEM_TYPES_SUPPORTED ((1 << TYPE_EPROM) | (1 << TYPE_FLASH_TYPE_3) | (1 << TYPE_SRAM))
+
 #ifdef __cplusplus
 extern "C" {
 #endif
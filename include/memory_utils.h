@@ -14,9 +14,18 @@ extern "C" {
 #define WRITE_FLAG 0
 #define READ_FLAG 1
 
+void mem_util_prepare_remap(const firestarter_handle_t* handle);
 uint32_t mem_util_remap_address_bus(const firestarter_handle_t* handle, uint32_t address, uint8_t read_write);
 void mem_util_blank_check(firestarter_handle_t* handle);
+void mem_util_resume_check(firestarter_handle_t* handle);
 void mem_util_set_address(firestarter_handle_t* handle, uint32_t address);
+
+// Reads one byte after the other from "address" without the firestarter_get_data call, the MSB
+// and control registers are only recalculated when the address moves out of the current 256 bytes.
+// When the low 8 lines aren't remapped only the LSB is stepped in between.
+// mem_util_burst_begin returns false when the memory type reads its own way.
+bool mem_util_burst_begin(firestarter_handle_t* handle, uint32_t address);
+uint8_t mem_util_burst_read(firestarter_handle_t* handle);
 rurp_register_t mem_util_calculate_lsb_register(firestarter_handle_t* handle, uint32_t address);
 rurp_register_t mem_util_calculate_msb_register(firestarter_handle_t* handle, uint32_t address);
 rurp_register_t mem_util_calculate_top_address_register(firestarter_handle_t* handle, uint32_t address);
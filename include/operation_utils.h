@@ -27,6 +27,25 @@ extern "C" {
 #define END 5
 #define ENDED 6
 
+// Time the host has to send the ACK for each phase, can be overridden with -D
+#ifndef ACK_TIMEOUT_INIT_MS
+#define ACK_TIMEOUT_INIT_MS 1000
+#endif
+#ifndef ACK_TIMEOUT_MAIN_MS
+#define ACK_TIMEOUT_MAIN_MS 1000
+#endif
+#ifndef ACK_TIMEOUT_END_MS
+#define ACK_TIMEOUT_END_MS 1000
+#endif
+#ifndef ACK_TIMEOUT_DATA_MS
+#define ACK_TIMEOUT_DATA_MS 1000
+#endif
+
+// Quiet time on the line before a corrupted packet is requested again
+#ifndef DRAIN_QUIET_MS
+#define DRAIN_QUIET_MS 10
+#endif
+
 #define OPERATION_IN_PROGRESS 0x40
 #define OPERATION_WAITING_FOR_DATA 0x80
 
@@ -35,9 +54,18 @@ enum op_message_type {
     OP_MSG_DONE,
     OP_MSG_DATA,
     OP_MSG_INCOMPLETE,
-    OP_MSG_ERROR
+    OP_MSG_ERROR,
+    OP_MSG_RESEND,
+    OP_MSG_CORRUPT,
+    OP_MSG_ABORT
 };
 
+typedef struct op_ack_stats {
+    uint16_t count;          // Number of ACKs received
+    unsigned long total_us;  // Sum of the time spent waiting
+    unsigned long max_us;    // Longest wait
+} op_ack_stats_t;
+
 
 static inline void set_operation_in_progress(firestarter_handle_t* handle) {
     handle->operation_state |= OPERATION_IN_PROGRESS;
@@ -79,6 +107,9 @@ bool op_execute_simple_operation(firestarter_handle_t* handle);
  *
  * This is the main engine for complex operations. It manages the INIT, MAIN, and END phases,
  * and calls the provided callback function to perform the work of the MAIN phase.
+ * Each phase waits for a host ACK unless FLAG_AUTO_ADVANCE is set, then the phases run
+ * back to back and their INIT/MAIN/END markers are sent without waiting.
+ * The closing ACK can be replaced by the next command, which is left on the stream.
  *
  * @param callback A function pointer to the main logic for the operation (e.g., reading or writing data).
  * @param handle Pointer to the firestarter handle.
@@ -104,26 +135,158 @@ bool op_execute_function(void (*callback)(firestarter_handle_t* handle), firesta
  */
 void op_reset_timeout();
 
+/**
+ * @brief Disables the chip and clears the registers.
+ *
+ * Done before the host is told the command has ended, it may send the next
+ * command right away and on the Uno the serial input is off while the bus is in use.
+ */
+void op_reset_bus();
+
 /**
  * @brief Parses the incoming serial stream for messages from the host.
  *
- * This function is non-blocking. It checks for "OK" (ACK), "DONE", and data packets ('#').
+ * This function is non-blocking. It checks for "OK" (ACK), "DONE", "RESEND", "ABORT" and data packets ('#').
+ * With FLAG_CRC a damaged or out of sequence data packet gives OP_MSG_CORRUPT instead of OP_MSG_ERROR.
  *
  * @param handle Pointer to the firestarter handle, used to store incoming data.
  * @return An op_message_type enum value indicating the message found, or OP_MSG_INCOMPLETE if no full message is available.
  */
 op_message_type op_get_message(firestarter_handle_t* handle);
 
+/**
+ * @brief Drops a partly matched keyword, called when the command is done.
+ *
+ * A keyword cut off by the end of a command must not swallow the start of the next one.
+ */
+void op_reset_keyword();
+
 /**
  * @brief Waits for an "OK" (ACK) message from the host.
  *
- * This is a blocking function with a timeout.
+ * This is a blocking function with a timeout of ACK_TIMEOUT_DATA_MS.
  *
  * @param handle Pointer to the firestarter handle.
  * @return true if an ACK was received, false on timeout or error.
  */
 bool op_wait_for_ack(firestarter_handle_t* handle);
 
+/**
+ * @brief Waits for an "OK" (ACK) message from the host with a given timeout.
+ *
+ * The serial stream is polled continuously, so the ACK is picked up as soon as it arrives.
+ * The time spent waiting is added to the ACK statistics.
+ *
+ * @param handle Pointer to the firestarter handle.
+ * @param timeout_ms Time to wait for the ACK in milliseconds.
+ * @return true if an ACK was received, false on timeout or error.
+ */
+bool op_wait_for_ack_timeout(firestarter_handle_t* handle, unsigned long timeout_ms);
+
+/**
+ * @brief Waits for the host to acknowledge or reject the data packet just sent.
+ *
+ * @param handle Pointer to the firestarter handle.
+ * @param timeout_ms Time to wait for the reply in milliseconds.
+ * @return OP_MSG_ACK, OP_MSG_RESEND if the host wants the packet again, or OP_MSG_ERROR on timeout, error or abort.
+ */
+op_message_type op_wait_for_reply(firestarter_handle_t* handle, unsigned long timeout_ms);
+
+/**
+ * @brief Checks if the host has sent "ABORT".
+ *
+ * This function is non-blocking and safe to call from the memory loops. Only an "ABORT"
+ * is consumed, other messages and data packets are left on the stream.
+ *
+ * @param handle Pointer to the firestarter handle.
+ * @return true once the host has asked to abort the current command.
+ */
+bool op_check_abort(firestarter_handle_t* handle);
+
+/**
+ * @brief Clears a received "ABORT", called when the command is done.
+ */
+void op_clear_abort();
+
+/**
+ * @brief Drops everything the host has sent so far, including a packet received ahead.
+ *
+ * Used after a corrupted packet, the line is drained until it has been quiet for
+ * DRAIN_QUIET_MS so the host's resend starts on a clean stream.
+ */
+void op_discard_input();
+
+/**
+ * @brief Resets the ACK wait statistics, called when a new command starts.
+ */
+void op_reset_ack_stats();
+
+/**
+ * @brief Returns the ACK wait statistics of the current command.
+ */
+const op_ack_stats_t* op_get_ack_stats();
+
+#ifdef DOUBLE_BUFFERING
+/**
+ * @brief Receives the next data packet into the upper half of the data buffer.
+ *
+ * This function is non-blocking and only consumes data packets ('#'), anything else
+ * is left for op_get_message.
+ *
+ * @param handle Pointer to the firestarter handle.
+ */
+void op_receive_ahead(firestarter_handle_t* handle);
+
+/**
+ * @brief Moves a data packet received ahead into the lower half of the data buffer.
+ *
+ * A packet that was only partially received is completed first.
+ *
+ * @param handle Pointer to the firestarter handle.
+ * @return OP_MSG_DATA when a packet was taken, OP_MSG_INCOMPLETE if none was started, or OP_MSG_ERROR.
+ */
+op_message_type op_take_received_ahead(firestarter_handle_t* handle);
+
+/**
+ * @brief Starts sending a data packet in the background.
+ *
+ * The header is sent right away, the data is sent by op_service_link as the link has
+ * room for it. The buffer must stay untouched until op_send_finish returns.
+ *
+ * @param buffer The packet data.
+ * @param size Size of the packet.
+ * @param seq Sequence number of the packet, only sent with FLAG_CRC.
+ */
+void op_send_begin(const char* buffer, size_t size, uint8_t seq);
+
+/**
+ * @brief Sends as much of the pending packet as the link accepts without blocking.
+ */
+void op_send_pending();
+
+/**
+ * @brief Sends the rest of the pending packet, blocking until it is handed to the link.
+ */
+void op_send_finish();
+#endif
+
+/**
+ * @brief Services the link while the bus is busy programming or verifying.
+ *
+ * Called from the memory loops, receives the next chunk or sends the previous one in
+ * the background when the data buffer is split for double buffering.
+ *
+ * @param handle Pointer to the firestarter handle.
+ */
+static inline void op_service_link(firestarter_handle_t* handle) {
+#ifdef DOUBLE_BUFFERING
+    if (handle->chunk_size <= DATA_BUFFER_SIZE / 2) {
+        op_receive_ahead(handle);
+        op_send_pending();
+    }
+#endif
+}
+
 /**
  * @brief Marks the MAIN phase of an operation as complete.
  *
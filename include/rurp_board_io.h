@@ -0,0 +1,181 @@
+/*
+ * Project Name: Firestarter
+ * Copyright (c) 2024 Henrik Olsson
+ *
+ * Permission is hereby granted under MIT license.
+ */
+
+#ifndef __RURP_BOARD_IO_H__
+#define __RURP_BOARD_IO_H__
+
+// Port level access to the shield for the per byte loops. The functions are inline so
+// strobes and direction changes compile down to a few port instructions at the call
+// site, the rurp_* C functions of the board files are wrappers around them.
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "rurp_shield.h"
+
+// Register cache, see rurp_register_utils.h
+extern uint8_t lsb_address;
+
+#if defined(ARDUINO_AVR_UNO)
+
+static inline void rurp_io_set_control_pin(uint8_t pin, uint8_t state) {
+    // Only the given pins on PORTB, the USER_BUTTON pull-up is left alone
+    if (state) {
+        PORTB |= pin;
+    } else {
+        PORTB &= ~pin;
+    }
+}
+
+static inline void rurp_io_set_data_output() {
+    DDRD = 0xff;
+}
+
+static inline void rurp_io_set_data_input() {
+    DDRD = 0x00;
+}
+
+static inline void rurp_io_write_data(uint8_t data) {
+    rurp_io_set_data_output();
+    PORTD = data;
+}
+
+static inline uint8_t rurp_io_read_data() {
+    return PIND;
+}
+
+#elif defined(ARDUINO_AVR_LEONARDO)
+
+#define PORTC_DATA_MASK 0x40
+#define PORTD_DATA_MASK 0x9f // D0(PD2), D1(PD3), D2(PD1), D3(PD0), D4(PD4), D7(PD7)
+#define PORTE_DATA_MASK 0x40
+
+#define PORTB_CONTROL_MASK 0xf0
+#define PORTD_CONTROL_MASK 0x40 // D12 (PD6)
+#define PORTC_CONTROL_MASK 0x80
+
+extern uint8_t control_pins;
+
+static inline void rurp_io_set_control_pin(uint8_t pin, uint8_t state) {
+    // Update the state of the logical control pins
+    control_pins = state ? (control_pins | pin) : (control_pins & ~pin);
+
+    // Map logical control_pins bits to physical port pins, only the ports of the
+    // given pins are written so a constant pin becomes a single port update.
+    // Logical Bit -> Arduino Pin -> MCU Pin
+    // ---------------------------------------
+    // Bit 0       -> D8          -> PB4
+    // Bit 1       -> D9          -> PB5
+    // Bit 2       -> D10         -> PB6
+    // Bit 3       -> D11         -> PB7
+    // Bit 4       -> D12         -> PD6
+    // Bit 5       -> D13         -> PC7
+    if (pin & 0x0F) {
+        PORTB = (PORTB & ~PORTB_CONTROL_MASK) | (control_pins << 4);
+    }
+    if (pin & 0x10) {
+        PORTD = (PORTD & ~PORTD_CONTROL_MASK) | ((control_pins & 0x10) << 2);
+    }
+    if (pin & 0x20) {
+        PORTC = (PORTC & ~PORTC_CONTROL_MASK) | ((control_pins & 0x20) << 2);
+    }
+}
+
+static inline void rurp_io_set_data_output() {
+    DDRD |= PORTD_DATA_MASK;
+    DDRC |= PORTC_DATA_MASK;
+    DDRE |= PORTE_DATA_MASK;
+}
+
+static inline void rurp_io_set_data_input() {
+    DDRD &= ~PORTD_DATA_MASK;
+    DDRC &= ~PORTC_DATA_MASK;
+    DDRE &= ~PORTE_DATA_MASK;
+}
+
+static inline void rurp_io_write_data(uint8_t data) {
+    rurp_io_set_data_output();
+
+    // Map data bus bits (D0-D7) to their respective port pins for Leonardo.
+    // Data Bit -> Arduino Pin -> MCU Pin
+    // -----------------------------------
+    // D0       -> D0          -> PD2
+    // D1       -> D1          -> PD3
+    // D2       -> D2          -> PD1
+    // D3       -> D3          -> PD0
+    // D4       -> D4          -> PD4
+    // D5       -> D5          -> PC6
+    // D6       -> D6          -> PD7
+    // D7       -> D7          -> PE6
+    uint8_t portd_val = ((data & _BV(0)) << 2) | // D0 to PD2
+                        ((data & _BV(1)) << 2) | // D1 to PD3
+                        ((data & _BV(2)) >> 1) | // D2 to PD1
+                        ((data & _BV(3)) >> 3) | // D3 to PD0
+                        (data & _BV(4)) |        // D4 to PD4
+                        ((data & _BV(6)) << 1);  // D6 to PD7
+
+    uint8_t portc_val = (data & _BV(5)) << 1;    // D5 to PC6
+    uint8_t porte_val = (data & _BV(7)) >> 1;    // D7 to PE6
+
+    PORTD = (PORTD & ~PORTD_DATA_MASK) | portd_val;
+    PORTC = (PORTC & ~PORTC_DATA_MASK) | portc_val;
+    PORTE = (PORTE & ~PORTE_DATA_MASK) | porte_val;
+}
+
+static inline uint8_t rurp_io_read_data() {
+    // Read from ports and map back to data bus bits (D0-D7)
+    uint8_t pind_val = PIND;
+    uint8_t pinc_val = PINC;
+    uint8_t pine_val = PINE;
+
+    uint8_t data = 0;
+    data |= ((pind_val & _BV(2)) >> 2); // PD2 -> D0
+    data |= ((pind_val & _BV(3)) >> 2); // PD3 -> D1
+    data |= ((pind_val & _BV(1)) << 1); // PD1 -> D2
+    data |= ((pind_val & _BV(0)) << 3); // PD0 -> D3
+    data |= (pind_val & _BV(4));        // PD4 -> D4
+    data |= ((pinc_val & _BV(6)) >> 1); // PC6 -> D5
+    data |= ((pind_val & _BV(7)) >> 1); // PD7 -> D6
+    data |= ((pine_val & _BV(6)) << 1); // PE6 -> D7
+    return data;
+}
+
+#else
+
+// Other boards go through the out of line functions
+#define rurp_io_set_control_pin(pin, state) rurp_set_control_pin(pin, state)
+#define rurp_io_set_data_output() rurp_set_data_output()
+#define rurp_io_set_data_input() rurp_set_data_input()
+#define rurp_io_write_data(data) rurp_write_data_buffer(data)
+#define rurp_io_read_data() rurp_read_data_buffer()
+
+#endif
+
+#define rurp_io_chip_enable() rurp_io_set_control_pin(CHIP_ENABLE, 0)
+#define rurp_io_chip_disable() rurp_io_set_control_pin(CHIP_ENABLE, 1)
+#define rurp_io_chip_output() rurp_io_set_control_pin(OUTPUT_ENABLE, 0)
+#define rurp_io_chip_input() rurp_io_set_control_pin(OUTPUT_ENABLE, 1)
+
+// Latches a value into one of the shield registers through the data bus
+static inline void rurp_io_strobe_register(uint8_t reg, uint8_t data) {
+    rurp_io_write_data(data);
+    rurp_io_set_control_pin(reg, 1);
+    // Probably useless - verify later
+    delayMicroseconds(1);
+    rurp_io_set_control_pin(reg, 0);
+}
+
+// Same as rurp_write_to_register(LEAST_SIGNIFICANT_BYTE, data), the latch is only
+// strobed when the address byte changes
+static inline void rurp_io_write_lsb(uint8_t data) {
+    if (lsb_address != data) {
+        lsb_address = data;
+        rurp_io_strobe_register(LEAST_SIGNIFICANT_BYTE, data);
+    }
+}
+
+#endif // __RURP_BOARD_IO_H__
@@ -3,6 +3,7 @@
 
 #include "rurp_shield.h"
 #include "rurp_internal_register_utils.h"
+#include "rurp_board_io.h"
 
 #ifdef HARDWARE_REVISION
 #include "rurp_hw_rev_utils.h"
@@ -60,12 +61,7 @@ void rurp_write_to_register(uint8_t reg, rurp_register_t data) {
 
 
 void rurp_internal_write_to_register(uint8_t reg, rurp_register_t data) {
-    rurp_write_data_buffer(data);
-    rurp_set_control_pin(reg, 1);
-    // Probably useless - verify later 
-    delayMicroseconds(1);
-
-    rurp_set_control_pin(reg, 0);
+    rurp_io_strobe_register(reg, data);
 }
 
 rurp_register_t rurp_read_from_register(uint8_t reg) {
@@ -7,9 +7,16 @@
 #include "firestarter.h"
 #include "logging.h"
 #ifndef SERIAL_PORT
+#ifdef ARDUINO_AVR_UNO
+// The UART is driven by the firmware instead of HardwareSerial
+#define RURP_UART
+#include "rurp_uart.h"
+#define SERIAL_PORT rurp_uart
+#else
 #include <Arduino.h>
 #define SERIAL_PORT Serial
 #endif
+#endif
 #ifdef SERIAL_DEBUG
 char* debug_msg_buffer;
 #endif
@@ -25,6 +32,22 @@ void rurp_serial_begin(unsigned long baud);
 
 void rurp_serial_end();
 
+#ifdef SERIAL_ON_IO
+// Two frames (10 bits each) of idle line at the configured baud rate
+#define SERIAL_IDLE_GUARD_US(baud) (20 * 1000000UL / (baud))
+
+void rurp_serial_detach();
+
+void rurp_serial_attach();
+#endif
+
+// Session baud rate, see CMD_BAUD
+bool rurp_communication_baud_supported(unsigned long baud);
+
+void rurp_communication_set_baud(unsigned long baud);
+
+unsigned long rurp_communication_get_baud();
+
 int rurp_communication_available();
 
 int rurp_communication_read();
@@ -33,7 +56,46 @@ int rurp_communication_peak();
 
 size_t rurp_communication_read_bytes(char* buffer, size_t size);
 
-int rurp_communication_read_data(char* buffer);
-size_t rurp_communication_write(const char* buffer, size_t size);
+// SLIP framing, RFC 1055
+#define SLIP_END 0xC0
+#define SLIP_ESC 0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+// Frame types, the first byte of every frame
+#define FRAME_ACK 'A'       // "OK" messages
+#define FRAME_DATA 'D'      // Data packet, header and data
+#define FRAME_PROGRESS 'G'  // "DATA" messages, progress and data announcements
+#define FRAME_LOG 'L'       // 'I', 'W' or 'E' and the message
+#define FRAME_PHASE 'P'     // 'I', 'M' or 'E' when INIT, MAIN or END is done
+
+// Sends all output as SLIP frames, see FLAG_FRAMED
+void rurp_communication_set_framed(bool enabled);
+
+// Ends a data packet written with rurp_communication_write_header/_raw
+void rurp_communication_write_end();
+
+// Selects CRC-16 and sequence numbered data packets, see FLAG_CRC
+void rurp_communication_set_crc(bool enabled);
+
+// Packet header size after the '#', size MSB/LSB plus checksum, or sequence and CRC
+uint8_t rurp_communication_header_size();
+
+bool rurp_communication_check_data(const uint8_t* header, const char* buffer, size_t size);
+
+int rurp_communication_read_data(char* buffer, size_t max_size, uint8_t* seq);
+
+// Discards input until the line has been quiet for quiet_ms
+void rurp_communication_drain(unsigned long quiet_ms);
+
+size_t rurp_communication_write(const char* buffer, size_t size, uint8_t seq);
+
+void rurp_communication_write_header(const char* buffer, size_t size, uint8_t seq);
+
+size_t rurp_communication_write_raw(const char* buffer, size_t size);
+
+int rurp_communication_available_for_write();
+
+void rurp_communication_flush();
 
 #endif  // __RURP_SERIAL_UTILS_H__
\ No newline at end of file
@@ -111,12 +111,28 @@ extern "C" {
 #define rurp_set_communication_mode() ((void)0)
 #endif
 
+    bool rurp_communication_baud_supported(unsigned long baud);
+    void rurp_communication_set_baud(unsigned long baud);
+    unsigned long rurp_communication_get_baud();
     int rurp_communication_available();
+    const rurp_rx_stats_t* rurp_communication_rx_stats();
+    void rurp_communication_reset_rx_stats();
     int rurp_communication_read();
     int rurp_communication_peak();
-    size_t rurp_communication_write(const char* buffer, size_t size);
+    size_t rurp_communication_write(const char* buffer, size_t size, uint8_t seq);
+    // Data packet split in parts, the header carries size and checksum of the whole packet
+    void rurp_communication_write_header(const char* buffer, size_t size, uint8_t seq);
+    size_t rurp_communication_write_raw(const char* buffer, size_t size);
+    void rurp_communication_write_end();
+    void rurp_communication_set_framed(bool enabled);
+    int rurp_communication_available_for_write();
+    void rurp_communication_flush();
     size_t rurp_communication_read_bytes(char* buffer, size_t length);
-    int rurp_communication_read_data(char* buffer);
+    int rurp_communication_read_data(char* buffer, size_t max_size, uint8_t* seq);
+    void rurp_communication_set_crc(bool enabled);
+    uint8_t rurp_communication_header_size();
+    bool rurp_communication_check_data(const uint8_t* header, const char* buffer, size_t size);
+    void rurp_communication_drain(unsigned long quiet_ms);
     
 
     void rurp_log(PGM_P type, const char* msg);
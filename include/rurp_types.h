@@ -23,4 +23,11 @@ typedef struct rurp_configuration {
     uint8_t hardware_revision;
 } rurp_configuration_t;
 
+// Bytes lost on the receive side of the link
+typedef struct rurp_rx_stats {
+    uint16_t ring_overflows;  // Receive ring full, byte dropped
+    uint16_t hw_overruns;     // UART data overrun, the ISR was held off too long
+    uint16_t frame_errors;    // Bad stop bit, usually a baud rate mismatch
+} rurp_rx_stats_t;
+
 #endif // __RURP_TYPES_H__
\ No newline at end of file
@@ -0,0 +1,45 @@
+/*
+ * Project Name: Firestarter
+ * Copyright (c) 2025 Henrik Olsson
+ *
+ * Permission is hereby granted under MIT license.
+ */
+
+#ifndef __RURP_UART_H__
+#define __RURP_UART_H__
+
+#include <Arduino.h>
+
+#include "firestarter.h"
+
+#if RX_BUFFER_SIZE > 256 || (RX_BUFFER_SIZE & (RX_BUFFER_SIZE - 1)) != 0
+#error "RX_BUFFER_SIZE must be a power of two up to 256"
+#endif
+#if TX_BUFFER_SIZE > 256 || (TX_BUFFER_SIZE & (TX_BUFFER_SIZE - 1)) != 0
+#error "TX_BUFFER_SIZE must be a power of two up to 256"
+#endif
+
+// USART0 driver with a receive ring serviced by the RX interrupt and a transmit
+// ring drained by the data register empty interrupt. Replaces HardwareSerial on
+// the Uno so the ring sizes are under firmware control and dropped bytes are counted.
+// write() returns as soon as the data is in the ring, flush() waits until the
+// last bit has left the UART.
+class RurpUart : public Stream {
+   public:
+    void begin(unsigned long baud);
+    void end();
+    operator bool() { return true; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+
+    size_t write(uint8_t data) override;
+    using Print::write;
+    int availableForWrite() override;
+    void flush() override;
+};
+
+extern RurpUart rurp_uart;
+
+#endif  // __RURP_UART_H__
@@ -0,0 +1,78 @@
+/*
+ * Project Name: Firestarter
+ * Copyright (c) 2025 Henrik Olsson
+ *
+ * Permission is hereby granted under MIT license.
+ */
+
+#include "binary_parser.h"
+
+#include <string.h>
+
+#include "crc16.h"
+#include "logging.h"
+
+static void set_bus_config(const bin_command_t* command, firestarter_handle_t* handle);
+
+int binary_parse(const char* buffer, size_t size, firestarter_handle_t* handle) {
+    if (size != BIN_CMD_SIZE || buffer[0] != BIN_CMD_START) {
+        firestarter_error_response_format("Bad cmd size: %d", (int)size);
+        return -1;
+    }
+    const bin_command_t* command = (const bin_command_t*)(buffer + 1);
+    const uint8_t* crc = (const uint8_t*)(buffer + 1 + sizeof(bin_command_t));
+    if (crc16_update(CRC16_INIT, command, sizeof(bin_command_t)) != ((crc[0] << 8) | crc[1])) {
+        firestarter_error_response("Bad cmd CRC");
+        return -1;
+    }
+    if (command->version != BIN_CMD_VERSION) {
+        firestarter_error_response_format("Bad cmd version: %d", command->version);
+        return -1;
+    }
+
+    handle->cmd = command->cmd;
+    handle->ctrl_flags = command->flags;
+    handle->mem_type = command->mem_type;
+    handle->pins = command->pins;
+    handle->mem_size = command->mem_size;
+    handle->address = command->address;
+    handle->vpp_mv = command->vpp_mv;
+    handle->pulse_delay = command->pulse_delay;
+    handle->chip_id = command->chip_id;
+    handle->window.size = command->window;
+    handle->chunk_size = command->chunk_size;
+    handle->resume_crc = command->resume_crc;
+    handle->access_ns = command->access_ns;
+    set_bus_config(command, handle);
+    return 0;
+}
+
+// Same mapping as the "bus-config" object of a JSON command
+static void set_bus_config(const bin_command_t* command, firestarter_handle_t* handle) {
+    bus_config_t* bus_config = &handle->bus_config;
+    bus_config->rw_line = command->rw_line;
+    bus_config->vpp_line = command->vpp_line;
+    bus_config->address_mask = 0;
+
+    uint8_t bus_size = command->bus_size;
+    if (bus_size > ADDRESS_LINES_SIZE) {
+        bus_size = ADDRESS_LINES_SIZE;
+    }
+    if (bus_size == 0) {
+        bus_config->address_lines[0] = 0xFF;
+        bus_config->address_mask = 0xFFFF;
+        return;
+    }
+
+    bus_config->matching_lines = bus_size;
+    for (uint8_t i = 0; i < bus_size; i++) {
+        bus_config->address_lines[i] = command->address_lines[i];
+        bus_config->address_mask |= 1UL << command->address_lines[i];
+        if (bus_config->matching_lines == bus_size && command->address_lines[i] != i) {
+            bus_config->matching_lines = i;
+        }
+    }
+    if (bus_size < ADDRESS_LINES_SIZE) {
+        bus_config->address_lines[bus_size] = 0xFF;
+    }
+}
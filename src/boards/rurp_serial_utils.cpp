@@ -6,28 +6,55 @@
  */
 #include <avr/pgmspace.h>
 
+#include "crc16.h"
 #include "rurp_serial_utils.h"
 #include "rurp_shield.h"
 
+#ifdef ARDUINO_AVR_LEONARDO
+// Data packets move whole USB endpoint banks instead of going through the CDC
+// Stream one byte at a time
+#define USB_BULK
+#endif
+
+// In framed mode all output is sent as SLIP frames, see FLAG_FRAMED
+static bool framed = false;
+static bool frame_open = false;
+
+static size_t _write_bulk(const char* buffer, size_t size);
+static void _frame_begin(uint8_t type);
+static void _frame_end();
+static void _frame_log(PGM_P type, const char* msg, PGM_P p_msg);
+
 // --- Core Logging Functions ---
 
 // Core logging function for RAM messages. Takes type from PROGMEM.
  void _firestarter_log_ram(PGM_P type, const char* msg) {
+    if (framed) {
+        _frame_log(type, msg, NULL);
+        return;
+    }
     SERIAL_PORT.print((const __FlashStringHelper*)type);
     SERIAL_PORT.print(F(": ")); 
     SERIAL_PORT.println(msg);
-    SERIAL_PORT.flush();
+    rurp_communication_flush();
 }
 
 // Core logging function for PROGMEM messages.
  void _firestarter_log_progmem(PGM_P type, PGM_P p_msg) {
+    if (framed) {
+        _frame_log(type, NULL, p_msg);
+        return;
+    }
     SERIAL_PORT.print((const __FlashStringHelper*)type);
     SERIAL_PORT.print(F(": "));
     SERIAL_PORT.println((const __FlashStringHelper*)p_msg);
-    SERIAL_PORT.flush();
+    rurp_communication_flush();
 }
 
+static unsigned long serial_baud = MONITOR_SPEED;
+
 void rurp_serial_begin(unsigned long baud) {
+    serial_baud = baud;
     SERIAL_PORT.begin(baud);
     while (!SERIAL_PORT) {
         delayMicroseconds(1);
@@ -40,6 +67,60 @@ void rurp_serial_end() {
     delay(5);
 }
 
+#ifdef SERIAL_ON_IO
+// Releases the UART pins to the data bus without tearing down the serial driver.
+// The baud rate and any already received bytes are kept for the next attach.
+void rurp_serial_detach() {
+    SERIAL_PORT.flush();
+    UCSR0B &= ~(_BV(RXEN0) | _BV(TXEN0));
+}
+
+// Hands the pins back to the UART. The TX line is held idle for a couple of frames
+// so the host UART can resync after the data bus toggled it.
+void rurp_serial_attach() {
+    UCSR0B |= _BV(RXEN0) | _BV(TXEN0);
+    delayMicroseconds(SERIAL_IDLE_GUARD_US(serial_baud));
+}
+#endif
+
+bool rurp_communication_baud_supported(unsigned long baud) {
+#ifdef SERIAL_ON_IO
+    // Double speed UART, the rate is F_CPU / 8 / (UBRR + 1) and must be within 2%
+    if (baud == 0 || baud > F_CPU / 8) {
+        return false;
+    }
+    unsigned long ubrr = (F_CPU / 4 / baud - 1) / 2;
+    unsigned long actual = F_CPU / 8 / (ubrr + 1);
+    unsigned long diff = actual > baud ? actual - baud : baud - actual;
+    return diff * 50 <= baud;
+#else
+    // USB CDC, the line rate set by the host has no effect
+    return baud > 0;
+#endif
+}
+
+void rurp_communication_set_baud(unsigned long baud) {
+    SERIAL_PORT.flush();
+    SERIAL_PORT.begin(baud);
+    serial_baud = baud;
+}
+
+unsigned long rurp_communication_get_baud() {
+    return serial_baud;
+}
+
+#ifndef RURP_UART
+// USB CDC is flow controlled, nothing is dropped
+static rurp_rx_stats_t rx_stats;
+
+const rurp_rx_stats_t* rurp_communication_rx_stats() {
+    return &rx_stats;
+}
+
+void rurp_communication_reset_rx_stats() {
+}
+#endif
+
 int rurp_communication_available() {
     return SERIAL_PORT.available();
 }
@@ -52,23 +133,62 @@ int rurp_communication_peak() {
     return SERIAL_PORT.peek();
 }
 
+#ifdef USB_BULK
+size_t rurp_communication_read_bytes(char* buffer, size_t size) {
+    size_t len = 0;
+    // A byte held by SERIAL_PORT.peek() isn't in the endpoint anymore
+    if (size > 0 && SERIAL_PORT.available() > USB_Available(CDC_RX)) {
+        buffer[len++] = SERIAL_PORT.read();
+    }
+    unsigned long last_rx = millis();
+    while (len < size && millis() - last_rx < TIMEOUT_MS) {
+        int count = USB_Recv(CDC_RX, buffer + len, size - len);
+        if (count > 0) {
+            len += count;
+            last_rx = millis();
+        }
+    }
+    return len;
+}
+#else
 size_t rurp_communication_read_bytes(char* buffer, size_t size) {
     return SERIAL_PORT.readBytes(buffer, size);
 }
+#endif
 
-int rurp_communication_read_data(char* buffer) {
-    uint8_t size_buf[2];
-    if (rurp_communication_read_bytes((char*)size_buf, 2) != 2) {
-        return -1;
+// In CRC mode a data packet carries a sequence number and a CRC-16 over size, sequence and data
+static bool crc_mode = false;
+
+void rurp_communication_set_crc(bool enabled) {
+    crc_mode = enabled;
+}
+
+uint8_t rurp_communication_header_size() {
+    return crc_mode ? 5 : 3;
+}
+
+bool rurp_communication_check_data(const uint8_t* header, const char* buffer, size_t size) {
+    if (crc_mode) {
+        uint16_t crc = crc16_update(CRC16_INIT, header, 3);
+        crc = crc16_update(crc, buffer, size);
+        return crc == ((header[3] << 8) | header[4]);
+    }
+    uint8_t checksum = 0;
+    for (size_t i = 0; i < size; i++) {
+        checksum ^= buffer[i];
     }
-    size_t data_size = (size_buf[0] << 8) | size_buf[1];
+    return checksum == header[2];
+}
 
-    uint8_t checksum_rcvd;
-    if (rurp_communication_read_bytes((char*)&checksum_rcvd, 1) != 1) {
+int rurp_communication_read_data(char* buffer, size_t max_size, uint8_t* seq) {
+    uint8_t header[5];
+    uint8_t header_size = rurp_communication_header_size();
+    if (rurp_communication_read_bytes((char*)header, header_size) != header_size) {
         return -1;
     }
+    size_t data_size = (header[0] << 8) | header[1];
 
-    if (data_size > DATA_BUFFER_SIZE) {
+    if (data_size > max_size) {
         // log_error_format("Bad size: %d", (int)handle->data_size);
         return -2;
     }
@@ -85,28 +205,155 @@ int rurp_communication_read_data(char* buffer) {
         len += rurp_communication_read_bytes(buffer + len, data_size - len);
     }
 
-    uint8_t checksum = 0;
-    for (size_t i = 0; i < len; i++) {
-        checksum ^= buffer[i];
-    }
-    if (checksum != checksum_rcvd) {
+    if (!rurp_communication_check_data(header, buffer, len)) {
         // log_error_format("Bad checksum %02X != %02X", checksum, checksum_rcvd);
         return -4;
     }
+    *seq = crc_mode ? header[2] : 0;
     return len;
 }
 
-size_t rurp_communication_write(const char* buffer, size_t size) {
-    uint8_t checksum = 0;
+void rurp_communication_drain(unsigned long quiet_ms) {
+    unsigned long last = millis();
+    while (millis() - last < quiet_ms) {
+        if (rurp_communication_available() > 0) {
+            rurp_communication_read();
+            last = millis();
+        }
+    }
+}
+
+void rurp_communication_write_header(const char* buffer, size_t size, uint8_t seq) {
+    uint8_t header[5];
+    header[0] = size >> 8;
+    header[1] = size & 0xFF;
+    if (crc_mode) {
+        header[2] = seq;
+        uint16_t crc = crc16_update(CRC16_INIT, header, 3);
+        crc = crc16_update(crc, buffer, size);
+        header[3] = crc >> 8;
+        header[4] = crc & 0xFF;
+    } else {
+        uint8_t checksum = 0;
+        for (size_t i = 0; i < size; i++) {
+            checksum ^= buffer[i];
+        }
+        header[2] = checksum;
+    }
+    if (framed) {
+        _frame_begin(FRAME_DATA);
+    }
+    rurp_communication_write_raw((const char*)header, rurp_communication_header_size());
+}
+
+size_t rurp_communication_write_raw(const char* buffer, size_t size) {
+    if (!frame_open) {
+        return _write_bulk(buffer, size);
+    }
+    // Runs without special bytes are written in one go
+    size_t start = 0;
     for (size_t i = 0; i < size; i++) {
-        checksum ^= buffer[i];
+        uint8_t c = buffer[i];
+        if (c == SLIP_END || c == SLIP_ESC) {
+            _write_bulk(buffer + start, i - start);
+            const char escaped[2] = {(char)SLIP_ESC, (char)(c == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC)};
+            _write_bulk(escaped, 2);
+            start = i + 1;
+        }
     }
+    _write_bulk(buffer + start, size - start);
+    return size;
+}
+
+void rurp_communication_write_end() {
+    if (frame_open) {
+        _frame_end();
+    }
+}
 
-    SERIAL_PORT.write(size >> 8);
-    SERIAL_PORT.write(size & 0xFF);
-    SERIAL_PORT.write(checksum);
-    size_t bytes = SERIAL_PORT.write(buffer, size);
+void rurp_communication_set_framed(bool enabled) {
+    framed = enabled;
+}
+
+static void _frame_begin(uint8_t type) {
+    // The leading END also drops anything the host received since the last frame
+    const char start[2] = {(char)SLIP_END, (char)type};
+    _write_bulk(start, 2);
+    frame_open = true;
+}
+
+static void _frame_end() {
+    const char end = (char)SLIP_END;
+    _write_bulk(&end, 1);
+    frame_open = false;
+}
+
+// Log, ack, phase and progress frames. Log and phase frames start with the first letter
+// of their type, INFO/WARN/ERROR and INIT/MAIN/END.
+static void _frame_log(PGM_P type, const char* msg, PGM_P p_msg) {
+    uint8_t frame_type = FRAME_LOG;
+    if (type == LOG_OK_MSG) {
+        frame_type = FRAME_ACK;
+    } else if (type == LOG_DATA_MSG) {
+        frame_type = FRAME_PROGRESS;
+    } else if (type == LOG_INIT_DONE_MSG || type == LOG_MAIN_DONE_MSG || type == LOG_END_DONE_MSG) {
+        frame_type = FRAME_PHASE;
+    }
+    _frame_begin(frame_type);
+    if (frame_type == FRAME_LOG || frame_type == FRAME_PHASE) {
+        char level = pgm_read_byte(type);
+        _write_bulk(&level, 1);
+    }
+    if (msg != NULL) {
+        rurp_communication_write_raw(msg, strlen(msg));
+    } else {
+        char buf[16];
+        size_t len;
+        while ((len = strlen_P(p_msg)) > 0) {
+            len = min(len, sizeof(buf));
+            memcpy_P(buf, p_msg, len);
+            rurp_communication_write_raw(buf, len);
+            p_msg += len;
+        }
+    }
+    _frame_end();
+    rurp_communication_flush();
+}
+
+#ifdef USB_BULK
+static size_t _write_bulk(const char* buffer, size_t size) {
+    int count = USB_Send(CDC_TX, buffer, size);
+    return count < 0 ? 0 : count;
+}
+
+int rurp_communication_available_for_write() {
+    return USB_SendSpace(CDC_TX);
+}
+#else
+static size_t _write_bulk(const char* buffer, size_t size) {
+    return SERIAL_PORT.write(buffer, size);
+}
+
+int rurp_communication_available_for_write() {
+    return SERIAL_PORT.availableForWrite();
+}
+#endif
+
+// Pushes the written data towards the host without waiting for it to be sent.
+// On the Uno the TX ring drains by itself, SERIAL_PORT.flush() is only needed
+// before the UART is detached or reconfigured.
+void rurp_communication_flush() {
+#ifndef RURP_UART
+    // Hands a partly filled USB bank to the host
     SERIAL_PORT.flush();
+#endif
+}
+
+size_t rurp_communication_write(const char* buffer, size_t size, uint8_t seq) {
+    rurp_communication_write_header(buffer, size, seq);
+    size_t bytes = rurp_communication_write_raw(buffer, size);
+    rurp_communication_write_end();
+    rurp_communication_flush();
     return bytes;
 }
 
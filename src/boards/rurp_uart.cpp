@@ -0,0 +1,166 @@
+/*
+ * Project Name: Firestarter
+ * Copyright (c) 2025 Henrik Olsson
+ *
+ * Permission is hereby granted under MIT license.
+ */
+
+#ifdef ARDUINO_AVR_UNO
+#include "rurp_uart.h"
+
+#include <avr/interrupt.h>
+
+RurpUart rurp_uart;
+
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
+static volatile rurp_rx_stats_t rx_stats;
+
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+static uint8_t tx_buffer[TX_BUFFER_SIZE];
+
+// Set on the first write, flush has nothing to wait for before that
+static bool tx_used = false;
+
+static inline void _clear_tx_complete() {
+    // Write one to clear, U2X0 must be kept
+    UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+}
+
+static inline void _tx_data_empty() {
+    UDR0 = tx_buffer[tx_tail];
+    _clear_tx_complete();
+    tx_tail = (tx_tail + 1) % TX_BUFFER_SIZE;
+    if (tx_head == tx_tail) {
+        UCSR0B &= ~_BV(UDRIE0);
+    }
+}
+
+// Sends from the ring when the interrupt can't run, otherwise waiting would never end
+static inline void _tx_poll() {
+    if (bit_is_clear(SREG, SREG_I) && (UCSR0B & _BV(UDRIE0)) && (UCSR0A & _BV(UDRE0))) {
+        _tx_data_empty();
+    }
+}
+
+ISR(USART_RX_vect) {
+    // The status must be read before the data register
+    uint8_t status = UCSR0A;
+    uint8_t data = UDR0;
+    if (status & _BV(DOR0)) {
+        rx_stats.hw_overruns++;
+    }
+    if (status & _BV(FE0)) {
+        rx_stats.frame_errors++;
+    }
+    uint8_t next = (rx_head + 1) % RX_BUFFER_SIZE;
+    if (next == rx_tail) {
+        rx_stats.ring_overflows++;
+        return;
+    }
+    rx_buffer[rx_head] = data;
+    rx_head = next;
+}
+
+ISR(USART_UDRE_vect) {
+    _tx_data_empty();
+}
+
+void RurpUart::begin(unsigned long baud) {
+    // Double speed mode gives exact rates at 0.5, 1 and 2 Mbaud
+    uint16_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+    uint8_t status = _BV(U2X0);
+    if (ubrr > 4095) {
+        ubrr = (F_CPU / 8 / baud - 1) / 2;
+        status = 0;
+    }
+    UCSR0B = 0;
+    UCSR0A = status;
+    UBRR0H = ubrr >> 8;
+    UBRR0L = ubrr & 0xFF;
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);  // 8N1
+    rx_head = rx_tail = 0;
+    tx_head = tx_tail = 0;
+    tx_used = false;
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void RurpUart::end() {
+    flush();
+    UCSR0B = 0;
+    rx_head = rx_tail = 0;
+}
+
+int RurpUart::available() {
+    return (RX_BUFFER_SIZE + rx_head - rx_tail) % RX_BUFFER_SIZE;
+}
+
+int RurpUart::read() {
+    if (rx_head == rx_tail) {
+        return -1;
+    }
+    uint8_t data = rx_buffer[rx_tail];
+    rx_tail = (rx_tail + 1) % RX_BUFFER_SIZE;
+    return data;
+}
+
+int RurpUart::peek() {
+    if (rx_head == rx_tail) {
+        return -1;
+    }
+    return rx_buffer[rx_tail];
+}
+
+size_t RurpUart::write(uint8_t data) {
+    tx_used = true;
+    // Nothing queued and the data register is free, skip the ring
+    if (tx_head == tx_tail && (UCSR0A & _BV(UDRE0))) {
+        uint8_t sreg = SREG;
+        cli();
+        UDR0 = data;
+        _clear_tx_complete();
+        SREG = sreg;
+        return 1;
+    }
+
+    uint8_t next = (tx_head + 1) % TX_BUFFER_SIZE;
+    while (next == tx_tail) {
+        _tx_poll();
+    }
+    tx_buffer[tx_head] = data;
+
+    uint8_t sreg = SREG;
+    cli();
+    tx_head = next;
+    UCSR0B |= _BV(UDRIE0);
+    SREG = sreg;
+    return 1;
+}
+
+int RurpUart::availableForWrite() {
+    return TX_BUFFER_SIZE - 1 - (TX_BUFFER_SIZE + tx_head - tx_tail) % TX_BUFFER_SIZE;
+}
+
+void RurpUart::flush() {
+    if (!tx_used) {
+        return;
+    }
+    // Wait for the ring to drain and the last frame to leave the shift register
+    while ((UCSR0B & _BV(UDRIE0)) || !(UCSR0A & _BV(TXC0))) {
+        _tx_poll();
+    }
+}
+
+const rurp_rx_stats_t* rurp_communication_rx_stats() {
+    return (const rurp_rx_stats_t*)&rx_stats;
+}
+
+void rurp_communication_reset_rx_stats() {
+    uint8_t sreg = SREG;
+    cli();
+    memset((void*)&rx_stats, 0, sizeof(rx_stats));
+    SREG = sreg;
+}
+#endif
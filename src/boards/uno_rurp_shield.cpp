@@ -16,7 +16,7 @@
 
 constexpr int INPUT_RESOLUTION = 1023;
 
-bool com_mode = true;
+bool com_mode = false;
 
 #ifdef SERIAL_DEBUG
 #define RX_DEBUG  A0
@@ -44,18 +44,28 @@ void rurp_board_setup() {
     rurp_write_to_register(MOST_SIGNIFICANT_BYTE, 0x00);
     rurp_write_to_register(CONTROL_REGISTER, 0x00);
 
-    rurp_set_communication_mode();
+    DDRD &= ~(0x01);
+    rurp_serial_begin(MONITOR_SPEED);
+    com_mode = true;
 }
 
+// Mode switches only toggle the UART enable bits, nested or repeated calls for
+// the mode already active are coalesced into no-ops.
 void rurp_set_communication_mode() {
+    if (com_mode) {
+        return;
+    }
     DDRD &= ~(0x01);
-    rurp_serial_begin(MONITOR_SPEED);
+    rurp_serial_attach();
     com_mode = true;
 }
 
 void rurp_set_programmer_mode() {
+    if (!com_mode) {
+        return;
+    }
     com_mode = false;
-    rurp_serial_end();
+    rurp_serial_detach();
     DDRD |= 0x01;
 }
 
@@ -81,14 +91,7 @@ void rurp_log_P(PGM_P type, PGM_P msg) {
 
 
 void rurp_set_control_pin(uint8_t pin, uint8_t state) {
-    // This function modifies only the specified control pin on PORTB,
-    // leaving other bits (like the USER_BUTTON pull-up) untouched.
-    // The original implementation was flawed and could clear other bits.
-    if (state) {
-        PORTB |= pin;
-    } else {
-        PORTB &= ~pin;
-    }
+    rurp_io_set_control_pin(pin, state);
 }
 
 uint8_t rurp_user_button_pressed() {
@@ -96,20 +99,19 @@ uint8_t rurp_user_button_pressed() {
 }
 
 void rurp_write_data_buffer(uint8_t data) {
-    rurp_set_data_output();
-    PORTD = data;
+    rurp_io_write_data(data);
 }
 
 uint8_t rurp_read_data_buffer() {
-    return PIND;
+    return rurp_io_read_data();
 }
 
 void rurp_set_data_output() {
-    DDRD = 0xff;
+    rurp_io_set_data_output();
 }
 
 void rurp_set_data_input() {
-    DDRD = 0x00;
+    rurp_io_set_data_input();
 }
 
 #ifdef SERIAL_DEBUG
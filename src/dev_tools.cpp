@@ -101,6 +101,7 @@ bool dt_set_registers(firestarter_handle_t* handle) {
 bool dt_set_address(firestarter_handle_t* handle) {
     log_info_format("CE: %d, OE: %d", is_flag_set(FLAG_CHIP_ENABLE), is_flag_set(FLAG_OUTPUT_ENABLE));
     log_info_format("Address: 0x%06x", handle->address);
+    mem_util_prepare_remap(handle);
     uint32_t address = mem_util_remap_address_bus(handle, handle->address, is_flag_set(FLAG_OUTPUT_ENABLE));
     log_info_format("Address: 0x%06x remappend", address);
 
@@ -14,6 +14,12 @@
 
 static inline bool _process_incoming_data(firestarter_handle_t* handle);
 static inline bool _process_outgoing_data(firestarter_handle_t* handle);
+static inline bool _stream_outgoing_data(firestarter_handle_t* handle);
+static inline bool _rewind_outgoing_data(firestarter_handle_t* handle);
+static inline bool _count_retransmit(firestarter_handle_t* handle);
+#ifdef DOUBLE_BUFFERING
+static inline bool _stream_outgoing_data_prefetch(firestarter_handle_t* handle);
+#endif
 
 bool eprom_read(firestarter_handle_t* handle) {
     return !op_execute_stateful_operation(_process_outgoing_data, handle);
@@ -57,11 +63,23 @@ bool eprom_blank_check(firestarter_handle_t* handle) {
     return !op_execute_simple_operation(handle);
 }
 
+bool eprom_calibrate(firestarter_handle_t* handle) {
+    debug("Calibrate PROM");
+    return !op_execute_simple_operation(handle);
+}
+
 // Returns true on success/continue, false on error.
 static inline bool _process_incoming_data(firestarter_handle_t* handle) {
     // The operation is "pull" based. The firmware requests a data chunk when it's ready.
     // This provides software flow control and allows for larger data chunks, improving speed.
     // We use a state flag to track if we are waiting for data.
+    //
+    // In windowed mode the host may have handle->window.size chunks in flight. The firmware
+    // acknowledges every programmed chunk with the cumulative number of completed chunks,
+    // "Ack 0" is sent once to start the stream.
+    //
+    // With FLAG_CRC a damaged chunk is answered with "Resend n", the host then sends again
+    // starting with chunk n.
     if (handle->address >= handle->mem_size) {
         set_operation_to_done(handle);
         return true;
@@ -69,20 +87,34 @@ static inline bool _process_incoming_data(firestarter_handle_t* handle) {
 
     // 1. Check for an incoming message from the host first. This prevents a race
     // condition where the firmware requests data after the host has already sent "DONE".
-    op_message_type msg_type = op_get_message(handle);
+    op_message_type msg_type = OP_MSG_INCOMPLETE;
+#ifdef DOUBLE_BUFFERING
+    // A chunk may already have been received while the previous one was programmed.
+    msg_type = op_take_received_ahead(handle);
+#endif
+    if (msg_type == OP_MSG_INCOMPLETE) {
+        msg_type = op_get_message(handle);
+    }
 
     if (msg_type == OP_MSG_INCOMPLETE) {
         // No message from host. If we are not already waiting for data, request it.
         if (!is_operation_waiting_for_data(handle)) {
-            // The host application shows its own progress, so we just ask for data.
-            send_ack_const("Req data");
+            if (handle->window.size > 0) {
+                send_ack_format("Ack %u", handle->window.seq);
+            } else {
+                // The host application shows its own progress, so we just ask for data.
+                send_ack_const("Req data");
+            }
             set_operation_waiting_for_data(handle);
         }
         return true;  // Continue waiting.
     }
 
-    // We have received a message. Clear the flag so we can request the next chunk.
-    clear_operation_waiting_for_data(handle);
+    // We have received a message. Clear the flag so we can request the next chunk,
+    // in windowed mode the ACK after programming takes the place of the request.
+    if (handle->window.size == 0) {
+        clear_operation_waiting_for_data(handle);
+    }
 
     switch (msg_type) {
         case OP_MSG_DONE:
@@ -96,6 +128,15 @@ static inline bool _process_incoming_data(firestarter_handle_t* handle) {
                 return false;
             }
             break;
+        case OP_MSG_CORRUPT:
+            if (!_count_retransmit(handle)) {
+                return false;
+            }
+            // Anything in flight after the damaged chunk is dropped and sent again
+            op_discard_input();
+            send_ack_format("Resend %u", handle->window.seq);
+            set_operation_waiting_for_data(handle);
+            return true;
         default:
             // An error occurred in op_get_message or an unexpected message was received.
             return false;
@@ -106,26 +147,162 @@ static inline bool _process_incoming_data(firestarter_handle_t* handle) {
     }
 
     handle->address += handle->data_size;
+    handle->window.seq++;
+    handle->window.retries = 0;
+    if (handle->window.size > 0) {
+        send_ack_format("Ack %u", handle->window.seq);
+        set_operation_waiting_for_data(handle);
+    }
     return true;
 }
 
 // Returns true on success/continue, false on error.
 static inline bool _process_outgoing_data(firestarter_handle_t* handle) {
+    if (handle->window.size > 0) {
+        return _stream_outgoing_data(handle);
+    }
+
     if (!op_execute_function(handle->firestarter_operation_main, handle)) {
         return false;  // Error, so finished.
     }
 
     // The host application shows its own progress, so we send a simple message.
     log_data_const("Sending data");
-    rurp_communication_write(handle->data_buffer, handle->data_size);
+    rurp_communication_write(handle->data_buffer, handle->data_size, handle->window.seq);
 
-    if (!op_wait_for_ack(handle)) {
+    op_message_type reply;
+    while ((reply = op_wait_for_reply(handle, ACK_TIMEOUT_DATA_MS)) == OP_MSG_RESEND) {
+        if (!_count_retransmit(handle)) {
+            return false;
+        }
+        rurp_communication_write(handle->data_buffer, handle->data_size, handle->window.seq);
+    }
+    if (reply != OP_MSG_ACK) {
         return false;
     }
 
+    handle->window.seq++;
+    handle->window.retries = 0;
     handle->address += handle->data_size;
     if (handle->address >= handle->mem_size) {
         set_operation_to_done(handle);
     }
     return true;
 }
+
+// Credit based read. Chunks are sent back to back as long as the host has granted credit,
+// each host ACK returns window.ack_chunks chunks of credit.
+// A "RESEND" from the host goes back to the first chunk it hasn't acknowledged.
+// Returns true on success/continue, false on error.
+static inline bool _stream_outgoing_data(firestarter_handle_t* handle) {
+    op_message_type msg_type;
+    while ((msg_type = op_get_message(handle)) != OP_MSG_INCOMPLETE) {
+        if (msg_type == OP_MSG_RESEND) {
+            if (!_rewind_outgoing_data(handle)) {
+                return false;
+            }
+            continue;
+        }
+        if (msg_type != OP_MSG_ACK) {
+            return false;
+        }
+        handle->window.retries = 0;
+        handle->window.credit += handle->window.ack_chunks;
+        if (handle->window.credit > handle->window.size) {
+            handle->window.credit = handle->window.size;
+        }
+        op_reset_timeout();
+    }
+
+    if (handle->address >= handle->mem_size) {
+        // All chunks are sent, wait until the host has acknowledged them
+        if (handle->window.credit == handle->window.size) {
+            set_operation_to_done(handle);
+        }
+        return true;
+    }
+
+    if (handle->window.credit == 0) {
+        return true;  // Wait for the host to return credit.
+    }
+
+#ifdef DOUBLE_BUFFERING
+    if (handle->chunk_size <= DATA_BUFFER_SIZE / 2) {
+        return _stream_outgoing_data_prefetch(handle);
+    }
+#endif
+
+    if (!op_execute_function(handle->firestarter_operation_main, handle)) {
+        return false;
+    }
+
+    log_data_const("Sending data");
+    rurp_communication_write(handle->data_buffer, handle->data_size, handle->window.seq);
+
+    handle->window.credit--;
+    handle->window.seq++;
+    handle->address += handle->data_size;
+    return true;
+}
+
+#ifdef DOUBLE_BUFFERING
+// Ping-pong read pipeline. Chunk N is moved to the upper half of the data buffer and sent
+// in the background while chunk N+1 is read from the chip into the lower half.
+// Returns true on success/continue, false on error.
+static inline bool _stream_outgoing_data_prefetch(firestarter_handle_t* handle) {
+    // Only the first chunk, or the first after going back, is read without anything to send alongside.
+    if ((handle->window.seq == 0 || handle->data_size == 0) && !op_execute_function(handle->firestarter_operation_main, handle)) {
+        return false;
+    }
+
+    char* outgoing = handle->data_buffer + DATA_BUFFER_SIZE / 2;
+    size_t size = handle->data_size;
+    memcpy(outgoing, handle->data_buffer, size);
+
+    log_data_const("Sending data");
+    op_send_begin(outgoing, size, handle->window.seq);
+
+    handle->window.credit--;
+    handle->window.seq++;
+    handle->address += size;
+
+    // The read is done in place, logging the response would end up inside the packet.
+    handle->response_msg[0] = '\0';
+    if (handle->address < handle->mem_size) {
+        handle->firestarter_operation_main(handle);
+    }
+    op_send_finish();
+    if (handle->response_code == RESPONSE_CODE_ERROR) {
+        log_error(handle->response_msg);
+        return false;
+    }
+    op_reset_timeout();
+    return true;
+}
+#endif
+
+// Go back N. The chunks the host hasn't acknowledged are sent again, the host drops any
+// it already has by their sequence number.
+// Returns true on success/continue, false on error.
+static inline bool _rewind_outgoing_data(firestarter_handle_t* handle) {
+    if (!_count_retransmit(handle)) {
+        return false;
+    }
+    handle->window.seq -= handle->window.size - handle->window.credit;
+    handle->window.credit = handle->window.size;
+    handle->address = handle->window.start + (uint32_t)handle->window.seq * handle->chunk_size;
+    // Nothing is read ahead for the new position
+    handle->data_size = 0;
+    op_reset_timeout();
+    return true;
+}
+
+// Returns false when the current chunk has been sent again too many times.
+static inline bool _count_retransmit(firestarter_handle_t* handle) {
+    if (++handle->window.retries > MAX_RETRANSMITS) {
+        log_error_const("Too many retries");
+        return false;
+    }
+    log_info_format("Resend %u", handle->window.seq);
+    return true;
+}
@@ -10,6 +10,7 @@
 #include <Arduino.h>
 #include <stdlib.h>
 
+#include "binary_parser.h"
 #include "eprom_operations.h"
 #include "hardware_operations.h"
 #include "json_parser.h"
@@ -27,11 +28,21 @@
 
 bool init_programmer(firestarter_handle_t* handle);
 bool parse_json(firestarter_handle_t* handle);
+bool parse_binary(firestarter_handle_t* handle);
+bool setup_memory_command(firestarter_handle_t* handle);
+size_t read_command(char* buffer, size_t size);
+size_t read_binary_command(char* buffer, size_t size);
+void negotiate_window(firestarter_handle_t* handle);
 void command_done(firestarter_handle_t* handle);
 
 firestarter_handle_t handle;
 
 unsigned long timeout = 0;
+unsigned long idle_since = 0;
+unsigned long requested_baud = 0;
+bool chunk_requested = false;
+// Set when the bus was reset at the end of the command, see op_reset_bus
+bool bus_idle = false;
 
 void setup() {
 #ifdef SERIAL_DEBUG
@@ -86,28 +97,7 @@ bool parse_json(firestarter_handle_t* handle) {
             log_error(handle->response_msg);
             return false;
         }
-#ifdef DEV_TOOLS
-        if (handle->cmd < CMD_DEV_ADDRESS) {
-#endif
-#ifdef EXTRA_INFO_LOGGING
-            log_info_format("Force: %d", is_flag_set(FLAG_FORCE));
-            log_info_format("Can erase: %d", is_flag_set(FLAG_CAN_ERASE));
-            log_info_format("Skip erase: %d", is_flag_set(FLAG_SKIP_ERASE));
-            log_info_format("Skip blank check: %d", is_flag_set(FLAG_SKIP_BLANK_CHECK));
-            log_info_format("VPE as VPP: %d", is_flag_set(FLAG_VPE_AS_VPP));
-#endif
-            if (!op_execute_function(configure_memory, handle)) {
-                log_error_const("Setup error");
-                return false;
-            }
-#ifdef DEV_TOOLS
-#ifdef EXTRA_INFO_LOGGING
-        } else {
-            log_info_format("Output enable: %d", is_flag_set(FLAG_OUTPUT_ENABLE));
-            log_info_format("Chip enable: %d", is_flag_set(FLAG_CHIP_ENABLE));
-#endif
-        }
-#endif
+        return setup_memory_command(handle);
     } else if (handle->cmd == CMD_CONFIG) {
         rurp_configuration_t* config = rurp_get_config();
         int res = json_parse_config(handle->data_buffer, tokens, token_count, config, handle);
@@ -117,29 +107,238 @@ bool parse_json(firestarter_handle_t* handle) {
         } else if (res == 1) {
             rurp_save_config(config);
         }
+    } else if (handle->cmd == CMD_BENCHMARK) {
+        handle->mem_size = 0;
+        json_parse(handle->data_buffer, tokens, token_count, handle);
+        if (handle->response_code == RESPONSE_CODE_ERROR || handle->mem_size == 0) {
+            log_error_const("Bad benchmark");
+            return false;
+        }
+        negotiate_window(handle);
+    } else if (handle->cmd == CMD_BAUD) {
+        if (json_parse_baud(handle->data_buffer, tokens, token_count, &requested_baud, handle) < 0) {
+            log_error_const("Bad baud");
+            return false;
+        }
     }
     return true;
 }
 
+/**
+ * @brief Sets up a binary command, see bin_command_t.
+ *
+ * The struct is copied straight into the handle, memory commands then get the same
+ * setup as their JSON counterparts. Commands with their own JSON fields (config
+ * updates, baud rate) are only available as JSON.
+ *
+ * @param handle Pointer to the firestarter handle, the command is in the data buffer.
+ * @return true if the command is ready to run, false on error.
+ */
+bool parse_binary(firestarter_handle_t* handle) {
+    debug("Parse binary");
+    handle->response_msg[0] = '\0';
+    if (binary_parse(handle->data_buffer, handle->data_size, handle) < 0) {
+        log_error(handle->response_msg);
+        return false;
+    }
+    if (handle->cmd == CMD_BAUD) {
+        log_error_const("JSON only cmd");
+        return false;
+    }
+    if (handle->cmd < CMD_READ_VPP) {
+        return setup_memory_command(handle);
+    }
+    if (handle->cmd == CMD_BENCHMARK) {
+        negotiate_window(handle);
+    }
+    return true;
+}
+
+bool setup_memory_command(firestarter_handle_t* handle) {
+    negotiate_window(handle);
+#ifdef DEV_TOOLS
+    if (handle->cmd < CMD_DEV_ADDRESS || handle->cmd > CMD_DEV_REGISTER) {
+#endif
+#ifdef EXTRA_INFO_LOGGING
+        log_info_format("Force: %d", is_flag_set(FLAG_FORCE));
+        log_info_format("Can erase: %d", is_flag_set(FLAG_CAN_ERASE));
+        log_info_format("Skip erase: %d", is_flag_set(FLAG_SKIP_ERASE));
+        log_info_format("Skip blank check: %d", is_flag_set(FLAG_SKIP_BLANK_CHECK));
+        log_info_format("VPE as VPP: %d", is_flag_set(FLAG_VPE_AS_VPP));
+#endif
+        if (!op_execute_function(configure_memory, handle)) {
+            log_error_const("Setup error");
+            return false;
+        }
+#ifdef DEV_TOOLS
+#ifdef EXTRA_INFO_LOGGING
+    } else {
+        log_info_format("Output enable: %d", is_flag_set(FLAG_OUTPUT_ENABLE));
+        log_info_format("Chip enable: %d", is_flag_set(FLAG_CHIP_ENABLE));
+#endif
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief Reads a JSON command object from the host.
+ *
+ * Tracks the brace depth of the incoming object (ignoring braces inside strings)
+ * and returns as soon as the closing '}' arrives, instead of waiting for the
+ * buffer to fill or the stream timeout to expire.
+ *
+ * @param buffer Buffer to store the command in, must start with '{' on the stream.
+ * @param size Size of the buffer, one byte is reserved for the null terminator.
+ * @return Number of bytes read, or 0 on timeout, overflow or malformed input.
+ */
+size_t read_command(char* buffer, size_t size) {
+    size_t len = 0;
+    uint8_t depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    unsigned long last_rx = millis();
+
+    while (len < size - 1) {
+        if (rurp_communication_available() <= 0) {
+            if (millis() - last_rx > TIMEOUT_MS) {
+                return 0;
+            }
+            continue;
+        }
+        last_rx = millis();
+        char c = rurp_communication_read();
+        buffer[len++] = c;
+
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}') {
+            if (depth == 0) {
+                return 0;
+            }
+            if (--depth == 0) {
+                return len;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads a binary command from the host.
+ *
+ * @param buffer Buffer to store the command in, must start with BIN_CMD_START on the stream.
+ * @param size Size of the buffer.
+ * @return Number of bytes read, or 0 on timeout.
+ */
+size_t read_binary_command(char* buffer, size_t size) {
+    size_t len = 0;
+    size_t expected = min(size, BIN_CMD_SIZE);
+    unsigned long last_rx = millis();
+
+    while (len < expected) {
+        if (rurp_communication_available() <= 0) {
+            if (millis() - last_rx > TIMEOUT_MS) {
+                return 0;
+            }
+            continue;
+        }
+        last_rx = millis();
+        len += rurp_communication_read_bytes(buffer + len, min((size_t)rurp_communication_available(), expected - len));
+    }
+    return len;
+}
+
+/**
+ * @brief Clamps the window and chunk size requested by the host to what the board can handle.
+ *
+ * On SERIAL_ON_IO boards the UART is detached while the bus is in use, so writes can't
+ * receive chunks ahead and the host may only return read credit once the window is used
+ * up (or the last chunk arrived). Elsewhere every chunk is acknowledged on its own, and
+ * with more than one chunk in flight the data buffer is split in two halves.
+ *
+ * A chunk has to fit in the data buffer, or its half when it is split. The blank check
+ * doesn't buffer anything, there the chunk size only sets how often progress is reported.
+ *
+ * @param handle Pointer to the firestarter handle.
+ */
+void negotiate_window(firestarter_handle_t* handle) {
+    if (handle->window.size > WINDOW_SIZE_MAX) {
+        handle->window.size = WINDOW_SIZE_MAX;
+    }
+    handle->window.ack_chunks = 1;
+#ifdef SERIAL_ON_IO
+    if (handle->cmd == CMD_READ) {
+        handle->window.ack_chunks = handle->window.size;
+    } else if (handle->window.size > 1) {
+        handle->window.size = 1;
+    }
+#endif
+    handle->window.credit = handle->window.size;
+    handle->window.seq = 0;
+    handle->window.retries = 0;
+    handle->window.start = handle->address;
+    rurp_communication_set_crc(is_flag_set(FLAG_CRC));
+
+    uint16_t limit = DATA_BUFFER_SIZE;
+#ifdef DOUBLE_BUFFERING
+    if (handle->window.size > 1) {
+        limit = DATA_BUFFER_SIZE / 2;
+    }
+#endif
+    chunk_requested = handle->chunk_size > 0;
+    if (handle->cmd == CMD_BLANK_CHECK) {
+        if (!chunk_requested) {
+            handle->chunk_size = BLANK_CHECK_CHUNK_SIZE;
+        }
+    } else if (!chunk_requested || handle->chunk_size > limit) {
+        handle->chunk_size = limit;
+    }
+}
+
 bool init_programmer(firestarter_handle_t* handle) {
     handle->response_code = RESPONSE_CODE_OK;
     handle->operation_state = 0;
+    handle->window.size = 0;
+    chunk_requested = false;
 
-    handle->data_size = rurp_communication_read_bytes(handle->data_buffer, DATA_BUFFER_SIZE);
+    op_reset_ack_stats();
+    rurp_communication_reset_rx_stats();
+    bool binary = rurp_communication_peak() == BIN_CMD_START;
+    unsigned long rx_start = micros();
+    if (binary) {
+        handle->data_size = read_binary_command(handle->data_buffer, DATA_BUFFER_SIZE);
+    } else {
+        handle->data_size = read_command(handle->data_buffer, DATA_BUFFER_SIZE);
+    }
+    unsigned long rx_time = micros() - rx_start;
 #ifdef EXTRA_INFO_LOGGING
     handle->ctrl_flags = 0x80;
     log_info_format("Buffer size: %d", handle->data_size);
 #endif
     if (handle->data_size == 0) {
-        log_error_const("Empty input");
+        log_error_const("Incomplete input");
         return false;
     }
     debug("Setup");
     handle->data_buffer[handle->data_size] = '\0';
 
-    if (!parse_json(handle)) {
+    unsigned long parse_start = micros();
+    if (!(binary ? parse_binary(handle) : parse_json(handle))) {
         return false;
     };
+    unsigned long parse_time = micros() - parse_start;
+    rurp_communication_set_framed(is_flag_set(FLAG_FRAMED));
 
 #ifdef EXTRA_INFO_LOGGING
     if (handle->cmd > CMD_IDLE && handle->cmd < CMD_READ_VPP) {
@@ -148,45 +347,72 @@ bool init_programmer(firestarter_handle_t* handle) {
         log_info_format("Matching lines %u", handle->bus_config.matching_lines);
     }
 #endif
+    log_info_format("Rx: %lu us, parse: %lu us (%s), ack: %lu us", rx_time, parse_time, binary ? "bin" : "json", micros() - rx_start);
 #ifdef HARDWARE_REVISION
 #define PARSE_RESPONSE "FW: " FW_VERSION ", HW: Rev%d, Cmd: 0x%02x"
-    send_ack_format(PARSE_RESPONSE, rurp_get_hardware_revision(), handle->cmd);
+    format(handle->response_msg, PARSE_RESPONSE, rurp_get_hardware_revision(), handle->cmd);
 #else
 #define PARSE_RESPONSE "FW: " FW_VERSION ", Cmd: 0x%02x"
-    send_ack_format(PARSE_RESPONSE, handle->cmd);
+    format(handle->response_msg, PARSE_RESPONSE, handle->cmd);
 #endif
+    // Negotiated options are only echoed when the host asked for them
+    if (handle->window.size > 0 || chunk_requested) {
+        format(handle->response_msg + strlen(handle->response_msg), ", Win: %u, Chunk: %u", handle->window.size, handle->chunk_size);
+        if (handle->cmd == CMD_READ) {
+            format(handle->response_msg + strlen(handle->response_msg), ", Ack: %u", handle->window.ack_chunks);
+        }
+    }
+    send_ack(handle->response_msg);
     op_reset_timeout();
     return true;
 }
 
 void command_done(firestarter_handle_t* handle) {
     debug("Cmd finished");
-    rurp_set_programmer_mode();
-    rurp_chip_disable();
-    rurp_write_to_register(CONTROL_REGISTER, 0x00);
-    rurp_write_to_register(LEAST_SIGNIFICANT_BYTE, 0x00);
-    rurp_write_to_register(MOST_SIGNIFICANT_BYTE, 0x00);
+    if (!bus_idle) {
+        op_reset_bus();
+    }
+    bus_idle = false;
+    if (handle->progress_data != NULL) {
+        // Left by a stepped operation that didn't finish
+        free(handle->progress_data);
+        handle->progress_data = NULL;
+    }
+    op_clear_abort();
     handle->cmd = CMD_IDLE;
-    rurp_set_communication_mode();
+    rurp_communication_set_crc(false);
+    rurp_communication_set_framed(false);
+    op_reset_keyword();
     handle->response_msg[0] = '\0';
+    idle_since = millis();
 }
 
 void loop() {
     if (handle.cmd != CMD_IDLE && timeout < millis()) {
         log_error_format_buf(handle.response_msg, "Cmd: %d, timeout", handle.cmd);
         command_done(&handle);
+        return;
+    } else if (handle.cmd != CMD_IDLE && op_check_abort(&handle)) {
+        log_error_format_buf(handle.response_msg, "Aborted at 0x%06lx", handle.address);
+        command_done(&handle);
+        return;
     } else if (handle.cmd == CMD_IDLE) {
         if (rurp_communication_available() > 0) {
-            // Look for the start of a JSON object '{' before trying to parse.
-            // This makes the command reception more robust against spurious
+            idle_since = millis();
+            // Look for the start of a JSON object '{' or a binary command before trying
+            // to parse. This makes the command reception more robust against spurious
             // characters on the serial line.
-            if (rurp_communication_peak() == '{') {
+            int peek = rurp_communication_peak();
+            if (peek == '{' || peek == BIN_CMD_START) {
                 if (init_programmer(&handle)) {
                     return;
                 }
             } else {
                 rurp_communication_read();  // Discard non-'{' character
             }
+        } else if (rurp_communication_get_baud() != MONITOR_SPEED && millis() - idle_since > BAUD_IDLE_REVERT_MS) {
+            // The host is gone or lost track of the negotiated rate, go back to the default
+            rurp_communication_set_baud(MONITOR_SPEED);
         }
         return;
     }
@@ -212,6 +438,9 @@ void loop() {
         case CMD_CHECK_CHIP_ID:
             finished = eprom_check_chip_id(&handle);
             break;
+        case CMD_CALIBRATE:
+            finished = eprom_calibrate(&handle);
+            break;
         case CMD_READ_VPP:
         case CMD_READ_VPE:
             finished = hw_read_voltage(&handle);
@@ -239,12 +468,28 @@ void loop() {
             finished = hw_get_config(&handle);
             break;
 
+        case CMD_BAUD:
+            finished = hw_set_baud(&handle, requested_baud);
+            break;
+
+        case CMD_BENCHMARK:
+            finished = hw_benchmark(&handle);
+            break;
+
+        case CMD_CAPABILITIES:
+            finished = fw_get_capabilities(&handle);
+            break;
+
         default:
             log_error_P_int_buf(handle.response_msg, "Unknown cmd: ", handle.cmd);
             finished = true;
             break;
     }
     if (finished) {
+        if (op_check_abort(&handle)) {
+            // Picked up by a wait inside the command, which ended it without a report
+            log_error_format_buf(handle.response_msg, "Aborted at 0x%06lx", handle.address);
+        }
         command_done(&handle);
     }
 }
@@ -252,3 +497,13 @@ void loop() {
 void op_reset_timeout() {
     timeout = millis() + TIMEOUT_MS;
 }
+
+void op_reset_bus() {
+    rurp_set_programmer_mode();
+    rurp_chip_disable();
+    rurp_write_to_register(CONTROL_REGISTER, 0x00);
+    rurp_write_to_register(LEAST_SIGNIFICANT_BYTE, 0x00);
+    rurp_write_to_register(MOST_SIGNIFICANT_BYTE, 0x00);
+    rurp_set_communication_mode();
+    bus_idle = true;
+}
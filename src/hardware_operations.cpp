@@ -5,6 +5,7 @@
 
 #include "firestarter.h"
 #include "logging.h"
+#include "memory.h"
 #include "operation_utils.h"
 #include "rurp_shield.h"
 #include "version.h"
@@ -79,6 +80,21 @@ bool fw_get_version(firestarter_handle_t* handle) {
     return true;
 }
 
+bool fw_get_capabilities(firestarter_handle_t* handle) {
+    debug("Get capabilities");
+#ifdef SERIAL_ON_IO
+    // Highest double speed UART rate, lower ones are checked on CMD_BAUD
+    unsigned long max_baud = F_CPU / 8;
+#else
+    // USB CDC, the line rate has no effect
+    unsigned long max_baud = 0;
+#endif
+    send_ack_format("Caps: 0x%04x, Chunk: %u, Win: %u, Sum: 0x%02x, Baud: %lu, Comp: 0x%02x, Types: 0x%02x",
+                    CAPABILITIES, DATA_BUFFER_SIZE, WINDOW_SIZE_MAX, CHECKSUM_CRC16_CCITT, max_baud, CODECS,
+                    MEM_TYPES_SUPPORTED);
+    return true;
+}
+
 #ifdef HARDWARE_REVISION
 bool hw_get_version(firestarter_handle_t* handle) {
     debug("Get HW version");
@@ -102,6 +118,89 @@ bool hw_get_config(firestarter_handle_t* handle) {
     return true;
 }
 
+// Pattern sent at the new baud rate, alternating bits and both edges
+static const uint8_t baud_test_pattern[] PROGMEM = {0x55, 0xAA, 0x00, 0xFF};
+#define BAUD_TEST_SIZE 64
+
+static bool _confirm_baud(firestarter_handle_t* handle) {
+    // The host switches when it has read the ACK and says "OK" at the new rate
+    if (!op_wait_for_ack_timeout(handle, BAUD_CONFIRM_MS)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < BAUD_TEST_SIZE; i++) {
+        handle->data_buffer[i] = pgm_read_byte(&baud_test_pattern[i & 0x03]);
+    }
+    log_data_const("Baud test");
+    rurp_communication_write(handle->data_buffer, BAUD_TEST_SIZE, 0);
+    // And acknowledges the test frame when it arrived intact
+    return op_wait_for_ack_timeout(handle, BAUD_CONFIRM_MS);
+}
+
+bool hw_set_baud(firestarter_handle_t* handle, unsigned long baud) {
+    debug("Set baud");
+    if (!rurp_communication_baud_supported(baud)) {
+        log_error_format("Baud %lu not supported", baud);
+        return true;
+    }
+    unsigned long previous = rurp_communication_get_baud();
+    send_ack_format("Baud: %lu", baud);
+    rurp_communication_set_baud(baud);
+    if (_confirm_baud(handle)) {
+        send_ack_format("Baud: %lu", baud);
+        return true;
+    }
+    rurp_communication_set_baud(previous);
+    log_error_format("Baud %lu failed, using %lu", baud, previous);
+    return true;
+}
+
+static unsigned long _kb_per_s(uint32_t bytes, unsigned long ms) {
+    return ms > 0 ? bytes * 1000 / ms / 1024 : 0;
+}
+
+// Moves memory-size bytes of data packets each way and reports the rate.
+// Firmware to host the packets are sent back to back and the host says "OK" when it has
+// them all, then the firmware acks "Send" and the host sends its packets ('#').
+bool hw_benchmark(firestarter_handle_t* handle) {
+    debug("Benchmark");
+    uint32_t size = handle->mem_size;
+
+    unsigned long start = millis();
+    handle->window.seq = 0;
+    for (uint32_t sent = 0; sent < size;) {
+        size_t len = min(size - sent, (uint32_t)handle->chunk_size);
+        rurp_communication_write(handle->data_buffer, len, handle->window.seq++);
+        sent += len;
+    }
+    if (!op_wait_for_ack_timeout(handle, ACK_TIMEOUT_DATA_MS)) {
+        return true;
+    }
+    unsigned long tx_ms = millis() - start;
+
+    send_ack_const("Send");
+    start = millis();
+    unsigned long last_rx = start;
+    handle->window.seq = 0;
+    for (uint32_t received = 0; received < size;) {
+        op_message_type msg_type = op_get_message(handle);
+        if (msg_type == OP_MSG_DATA) {
+            received += handle->data_size;
+            handle->window.seq++;
+            last_rx = millis();
+        } else if (msg_type != OP_MSG_INCOMPLETE) {
+            log_error_const("Bad data");
+            return true;
+        } else if (millis() - last_rx > TIMEOUT_MS) {
+            log_error_const("Timeout");
+            return true;
+        }
+    }
+    unsigned long rx_ms = millis() - start;
+
+    send_ack_format("Tx: %lu KB/s, Rx: %lu KB/s", _kb_per_s(size, tx_ms), _kb_per_s(size, rx_ms));
+    return true;
+}
+
 #ifdef HARDWARE_REVISION
 void hw_version_override(char* revStr) {
     rurp_configuration_t* rurp_config = rurp_get_config();
@@ -23,6 +23,10 @@ bool get_type(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t
 bool get_pin_count(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
 bool get_delay(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
 bool get_vpp_mv(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
+bool get_window(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
+bool get_chunk_size(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
+bool get_resume_crc(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
+bool get_access_ns(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
 
 bool get_rw_pin(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
 bool get_vpp_pin(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle);
@@ -30,6 +34,7 @@ bool get_vpp_pin(const char* json, jsmntok_t* tokens, int pos, firestarter_handl
 bool get_r1(const char* json, jsmntok_t* tokens, int pos, rurp_configuration_t* config);
 bool get_r2(const char* json, jsmntok_t* tokens, int pos, rurp_configuration_t* config);
 bool get_rev(const char* json, jsmntok_t* tokens, int pos, rurp_configuration_t* config);
+bool get_baud(const char* json, jsmntok_t* tokens, int pos, unsigned long* baud);
 
 static int jsoneq_(const char* json, jsmntok_t* tok, const char* s);
 
@@ -60,6 +65,10 @@ const char key_pin_count[] PROGMEM = "pin-count";
 const char key_pulse_delay[] PROGMEM = "pulse-delay";
 const char key_vpp[] PROGMEM = "vpp";
 const char key_type[] PROGMEM = "type";
+const char key_window[] PROGMEM = "window";
+const char key_chunk_size[] PROGMEM = "chunk-size";
+const char key_resume_crc[] PROGMEM = "resume-crc";
+const char key_access_ns[] PROGMEM = "access-ns";
 
 typedef struct {
     PGM_P key;
@@ -69,7 +78,8 @@ typedef struct {
 static const key_parser_t key_parsers[] PROGMEM = {
     {key_mem_size, get_memory_size}, {key_address, get_address},       {key_flags, get_flags},
     {key_chip_id, get_chip_id},      {key_pin_count, get_pin_count},   {key_pulse_delay, get_delay},
-    {key_vpp, get_vpp_mv},           {key_type, get_type},
+    {key_vpp, get_vpp_mv},           {key_type, get_type},             {key_window, get_window},
+    {key_chunk_size, get_chunk_size}, {key_resume_crc, get_resume_crc}, {key_access_ns, get_access_ns},
 };
 
 int json_parse(const char* json, jsmntok_t* tokens, int token_count, firestarter_handle_t* handle) {
@@ -80,6 +90,10 @@ int json_parse(const char* json, jsmntok_t* tokens, int token_count, firestarter
     handle->bus_config.address_lines[0] = 0xFF;
     handle->bus_config.address_mask = 0;
     handle->chip_id = 0;
+    handle->window.size = 0;
+    handle->chunk_size = 0;
+    handle->resume_crc = 0;
+    handle->access_ns = 0;
 
     if (token_count < 1 || tokens[0].type != JSMN_OBJECT) {
         return -1; // Not a JSON object
@@ -163,6 +177,22 @@ int json_parse_config(const char* json, jsmntok_t* tokens, int token_count, rurp
     return res;
 }
 
+int json_parse_baud(const char* json, jsmntok_t* tokens, int token_count, unsigned long* baud, firestarter_handle_t* handle) {
+    *baud = 0;
+    for (int i = 1; i < token_count; i++) {
+        if (get_cmd(json, tokens, i) != 0xFF) {
+            i++;
+        } else if (get_flags(json, tokens, i, handle)) {
+            i++;
+        } else if (get_baud(json, tokens, i, baud)) {
+            i++;
+        } else {
+            return -1;
+        }
+    }
+    return *baud > 0 ? 0 : -1;
+}
+
 uint8_t json_get_cmd(const char* json, jsmntok_t* tokens, int token_count, firestarter_handle_t* handle) {
     handle->cmd = 0xFF;
     handle->ctrl_flags = 0;
@@ -261,6 +291,15 @@ static int jsoneq_(const char* json, jsmntok_t* tok, const char* s) {
 
 #define extract_int(element, register) extract_long(element, register)
 
+// For narrow fields, a larger value is clamped instead of wrapping around
+#define extract_clamped(element, register, max)                             \
+    if (jsoneq(json, &tokens[pos], element) == 0) {                         \
+        unsigned long value = simple_strtoul(json + tokens[pos + 1].start); \
+        register = value > (max) ? (max) : value;                           \
+        return 1;                                                           \
+    }                                                                       \
+    return 0;
+
 bool get_flags(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle) {
     extract_long("flags", handle->ctrl_flags);
 }
@@ -293,6 +332,30 @@ bool get_vpp_mv(const char* json, jsmntok_t* tokens, int pos, firestarter_handle
     extract_int("vpp", handle->vpp_mv);
 }
 
+bool get_window(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle) {
+    // Clamped before it's narrowed to the uint8_t field, 256 would otherwise become 0
+    if (jsoneq(json, &tokens[pos], "window") == 0) {
+        unsigned long window = simple_strtoul(json + tokens[pos + 1].start);
+        handle->window.size = window > WINDOW_SIZE_MAX ? WINDOW_SIZE_MAX : window;
+        return 1;
+    }
+    return 0;
+}
+
+bool get_chunk_size(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle) {
+    // Clamped here, negotiate_window limits it further to the buffer
+    extract_clamped("chunk-size", handle->chunk_size, 0xFFFFUL);
+}
+
+bool get_resume_crc(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle) {
+    extract_int("resume-crc", handle->resume_crc);
+}
+
+bool get_access_ns(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle) {
+    // Clamped to the longest wait, a wrapped value would read too early
+    extract_clamped("access-ns", handle->access_ns, 0xFFFFUL);
+}
+
 bool get_rw_pin(const char* json, jsmntok_t* tokens, int pos, firestarter_handle_t* handle) {
     extract_int("rw-pin", handle->bus_config.rw_line);
 }
@@ -312,3 +375,7 @@ bool get_r2(const char* json, jsmntok_t* tokens, int pos, rurp_configuration_t*
 bool get_rev(const char* json, jsmntok_t* tokens, int pos, rurp_configuration_t* config) {
     extract_int("rev", config->hardware_revision);
 }
+
+bool get_baud(const char* json, jsmntok_t* tokens, int pos, unsigned long* baud) {
+    extract_long("baud", *baud);
+}
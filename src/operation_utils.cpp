@@ -10,6 +10,7 @@
 #include <Arduino.h>
 #include <stdlib.h>
 
+#include "binary_parser.h"
 #include "firestarter.h"
 #include "logging.h"
 #include "rurp_shield.h"
@@ -38,11 +39,53 @@
 #define is_all_operations_done() \
     is_operation_started(ENDED)
 
+// In auto-advance mode the host doesn't acknowledge phase changes
+#define is_auto_advance() \
+    is_flag_set(FLAG_AUTO_ADVANCE)
+
 static inline bool _check_response(firestarter_handle_t* handle);
 static inline int _execute_operation(void (*callback)(firestarter_handle_t* handle), firestarter_handle_t* handle);
 static inline int _execute_operation_house_keeping(firestarter_handle_t* handle);
 static inline int _execute_operation_house_keeping_func(void (*callback)(firestarter_handle_t* handle), int state, firestarter_handle_t* handle);
 static inline bool _single_step_operation_callback(firestarter_handle_t* handle);
+static inline void _log_throughput(firestarter_handle_t* handle);
+
+// Start of the MAIN phase, used to report the transfer rate when it is done
+static unsigned long main_start_ms = 0;
+static uint32_t main_start_address = 0;
+
+static op_ack_stats_t ack_stats;
+
+// Set when the host has sent "ABORT", the command is stopped by the main loop
+static bool aborted = false;
+
+// Keyword being matched, the input may end in the middle of one
+static PGM_P keyword = NULL;
+static uint8_t keyword_pos = 0;
+static op_message_type keyword_type;
+
+#ifdef DOUBLE_BUFFERING
+#define AHEAD_IDLE 0
+#define AHEAD_HEADER 1
+#define AHEAD_DATA 2
+#define AHEAD_READY 3
+#define AHEAD_ERROR 4
+
+// A data packet ('#', header, data) received in the background
+static struct {
+    uint8_t state;
+    uint8_t header_len;
+    uint8_t header[5];
+    uint16_t size;
+    uint16_t len;
+} ahead;
+
+// A data packet sent in the background
+static struct {
+    const char* data;
+    uint16_t len;
+} pending;
+#endif
 
 /**
  * @brief Executes a simple, non-stateful operation.
@@ -65,6 +108,15 @@ bool op_execute_stateful_operation(bool (*callback)(firestarter_handle_t* handle
             // The operation is complete from the firmware's perspective.
             // The host sends a final ACK to close the transaction.
             // We wait for it and then signal that the command is finished.
+            if (is_auto_advance()) {
+                return false;
+            }
+            // A host that pipelines sends the next command instead, it closes this one
+            // and is left on the stream so the main loop can start it right away
+            int peek = rurp_communication_available() > 0 ? rurp_communication_peak() : -1;
+            if (keyword == NULL && (peek == '{' || peek == BIN_CMD_START)) {
+                return false;
+            }
             if (op_get_message(handle) == OP_MSG_INCOMPLETE) {
                 return true;  // Not finished yet, waiting for final ACK
             }
@@ -104,69 +156,123 @@ bool op_execute_function(void (*callback)(firestarter_handle_t* handle), firesta
 }
 
 bool op_wait_for_ack(firestarter_handle_t* handle) {
-    unsigned long timeout = millis() + 1000;
-    while (millis() < timeout) {
+    return op_wait_for_ack_timeout(handle, ACK_TIMEOUT_DATA_MS);
+}
+
+bool op_wait_for_ack_timeout(firestarter_handle_t* handle, unsigned long timeout_ms) {
+    return op_wait_for_reply(handle, timeout_ms) == OP_MSG_ACK;
+}
+
+op_message_type op_wait_for_reply(firestarter_handle_t* handle, unsigned long timeout_ms) {
+    unsigned long start_ms = millis();
+    unsigned long start_us = micros();
+    while (millis() - start_ms < timeout_ms) {
         op_message_type msg_type = op_get_message(handle);
         if (msg_type == OP_MSG_ACK) {
-            return true;
+            unsigned long wait_us = micros() - start_us;
+            ack_stats.count++;
+            ack_stats.total_us += wait_us;
+            if (wait_us > ack_stats.max_us) {
+                ack_stats.max_us = wait_us;
+            }
+            return OP_MSG_ACK;
         }
-        if (msg_type == OP_MSG_ERROR) {
-            return false;
+        if (msg_type == OP_MSG_RESEND) {
+            return OP_MSG_RESEND;
+        }
+        if (msg_type == OP_MSG_ERROR || msg_type == OP_MSG_ABORT) {
+            return OP_MSG_ERROR;
         }
-        delay(10);
     }
     log_error_const("Timeout");
-    return false;
+    return OP_MSG_ERROR;
+}
+
+void op_reset_ack_stats() {
+    memset(&ack_stats, 0, sizeof(ack_stats));
+}
+
+const op_ack_stats_t* op_get_ack_stats() {
+    return &ack_stats;
+}
+
+void op_reset_keyword() {
+    keyword = NULL;
+}
+
+static bool _start_keyword(char c) {
+    switch (c) {
+        case 'O':
+            keyword = PSTR("OK");
+            keyword_type = OP_MSG_ACK;
+            break;
+        case 'D':
+            keyword = PSTR("DONE");
+            keyword_type = OP_MSG_DONE;
+            break;
+        case 'R':
+            keyword = PSTR("RESEND");
+            keyword_type = OP_MSG_RESEND;
+            break;
+        case 'A':
+            keyword = PSTR("ABORT");
+            keyword_type = OP_MSG_ABORT;
+            break;
+        default:
+            return false;
+    }
+    keyword_pos = 0;
+    return true;
 }
 
 /**
  * @brief Parses the incoming serial stream for messages from the host.
  *
- * This function is non-blocking. It checks for "OK" (ACK), "DONE", and data packets ('#').
- * It consumes junk characters until a valid message start is found.
+ * This function is non-blocking. It checks for "OK" (ACK), "DONE", "RESEND", "ABORT" and data packets ('#').
+ * Keywords are matched one character at a time, a character that doesn't match is left
+ * on the stream so it can start the next message. Other characters are consumed as junk.
+ * With FLAG_CRC a damaged or out of sequence packet is reported as OP_MSG_CORRUPT so it
+ * can be requested again.
  * @param handle Pointer to the firestarter handle, used to store incoming data.
  * @return An op_message_type enum value indicating the message found, or OP_MSG_INCOMPLETE if no full message is available.
  */
 op_message_type op_get_message(firestarter_handle_t* handle) {
-    if (rurp_communication_available() <= 0) {
-        return OP_MSG_INCOMPLETE;
-    }
-    // log_info_format("op_get_message: %d bytes available", rurp_communication_available());
     while (rurp_communication_available() > 0) {
         int peek = rurp_communication_peak();
-        switch (peek) {
-            case 'O':  // Potential "OK"
-                // log_info_const("op_get_message: Found 'O'");
-                if (rurp_communication_available() < 2) {
-                    return OP_MSG_INCOMPLETE;
-                }
-                rurp_communication_read();  // consume 'O'
-                if (rurp_communication_peak() == 'K') {
-                    rurp_communication_read();  // consume 'K'
-                    // log_info_const("op_get_message: ACK received");
-                    return OP_MSG_ACK;
-                }
-                // Not "OK", 'O' is consumed. Loop will treat next char as junk.
-                break;
-
-            case 'D':  // Potential "DONE"
-                if (rurp_communication_available() < 4) {
-                    return OP_MSG_INCOMPLETE;
-                }
-                char done_buf[4];
-                rurp_communication_read_bytes(done_buf, 4);
-                if (strncmp_P(done_buf, PSTR("DONE"), 4) == 0) {
-                    return OP_MSG_DONE;
+        if (keyword != NULL) {
+            if (peek == (char)pgm_read_byte(keyword + keyword_pos)) {
+                rurp_communication_read();
+                if (pgm_read_byte(keyword + ++keyword_pos) == '\0') {
+                    keyword = NULL;
+                    if (keyword_type == OP_MSG_ABORT) {
+                        aborted = true;
+                    }
+                    return keyword_type;
                 }
-                // Not "DONE", 4 bytes consumed. This is a risk.
-                break;
-
+                continue;
+            }
+            // The last character read may start another keyword, as in "DOK"
+            char last = pgm_read_byte(keyword + keyword_pos - 1);
+            keyword = NULL;
+            if (keyword_pos > 1 && _start_keyword(last)) {
+                keyword_pos = 1;
+            }
+            continue;
+        }
+        if (_start_keyword(peek)) {
+            continue;
+        }
+        switch (peek) {
             case '#': {  // Data packet
                 if (rurp_communication_available() < 4) {
                     return OP_MSG_INCOMPLETE;
                 }
                 rurp_communication_read();  // consume '#'
-                int res = rurp_communication_read_data(handle->data_buffer);
+                uint8_t seq;
+                int res = rurp_communication_read_data(handle->data_buffer, handle->chunk_size, &seq);
+                if (is_flag_set(FLAG_CRC) && (res < 0 || seq != (uint8_t)handle->window.seq)) {
+                    return OP_MSG_CORRUPT;
+                }
                 if (res < 0) {
                     log_error_P_int("Data err ", res);
                     return OP_MSG_ERROR;
@@ -183,8 +289,120 @@ op_message_type op_get_message(firestarter_handle_t* handle) {
     return OP_MSG_INCOMPLETE;  // Nothing in buffer
 }
 
+bool op_check_abort(firestarter_handle_t* handle) {
+#ifdef DOUBLE_BUFFERING
+    if (ahead.state == AHEAD_HEADER || ahead.state == AHEAD_DATA) {
+        return aborted;  // In the middle of a data packet
+    }
+#endif
+    if (!aborted && rurp_communication_available() > 0 &&
+        (keyword != NULL ? keyword_type == OP_MSG_ABORT : rurp_communication_peak() == 'A')) {
+        op_get_message(handle);
+    }
+    return aborted;
+}
+
+void op_clear_abort() {
+    aborted = false;
+}
+
+#ifdef DOUBLE_BUFFERING
+
+void op_receive_ahead(firestarter_handle_t* handle) {
+    char* buffer = handle->data_buffer + DATA_BUFFER_SIZE / 2;
+    while (ahead.state < AHEAD_READY && rurp_communication_available() > 0) {
+        switch (ahead.state) {
+            case AHEAD_IDLE:
+                if (rurp_communication_peak() != '#') {
+                    return;  // Not a data packet, left for op_get_message
+                }
+                rurp_communication_read();
+                ahead.header_len = 0;
+                ahead.state = AHEAD_HEADER;
+                break;
+            case AHEAD_HEADER:
+                ahead.header[ahead.header_len++] = rurp_communication_read();
+                if (ahead.header_len == rurp_communication_header_size()) {
+                    ahead.size = (ahead.header[0] << 8) | ahead.header[1];
+                    ahead.len = 0;
+                    ahead.state = ahead.size > DATA_BUFFER_SIZE / 2 ? AHEAD_ERROR : AHEAD_DATA;
+                }
+                break;
+            case AHEAD_DATA: {
+                size_t count = min(rurp_communication_available(), ahead.size - ahead.len);
+                ahead.len += rurp_communication_read_bytes(buffer + ahead.len, count);
+                break;
+            }
+        }
+        if (ahead.state == AHEAD_DATA && ahead.len == ahead.size) {
+            ahead.state = AHEAD_READY;
+        }
+    }
+}
+
+op_message_type op_take_received_ahead(firestarter_handle_t* handle) {
+    if (ahead.state == AHEAD_IDLE) {
+        return OP_MSG_INCOMPLETE;
+    }
+    unsigned long start = millis();
+    while (ahead.state < AHEAD_READY) {
+        if (millis() - start > TIMEOUT_MS) {
+            ahead.state = AHEAD_ERROR;
+            break;
+        }
+        op_receive_ahead(handle);
+    }
+    const char* buffer = handle->data_buffer + DATA_BUFFER_SIZE / 2;
+    bool valid = ahead.state == AHEAD_READY && rurp_communication_check_data(ahead.header, buffer, ahead.len);
+    ahead.state = AHEAD_IDLE;
+    if (is_flag_set(FLAG_CRC) && (!valid || ahead.header[2] != (uint8_t)handle->window.seq)) {
+        return OP_MSG_CORRUPT;
+    }
+    if (!valid) {
+        log_error_const("Data err ahead");
+        return OP_MSG_ERROR;
+    }
+    memcpy(handle->data_buffer, buffer, ahead.len);
+    handle->data_size = ahead.len;
+    return OP_MSG_DATA;
+}
+
+void op_send_begin(const char* buffer, size_t size, uint8_t seq) {
+    rurp_communication_write_header(buffer, size, seq);
+    pending.data = buffer;
+    pending.len = size;
+}
+
+void op_send_pending() {
+    if (pending.len == 0) {
+        return;
+    }
+    int space = rurp_communication_available_for_write();
+    if (space > 0) {
+        size_t sent = rurp_communication_write_raw(pending.data, min((size_t)space, pending.len));
+        pending.data += sent;
+        pending.len -= sent;
+    }
+}
+
+void op_send_finish() {
+    rurp_communication_write_raw(pending.data, pending.len);
+    rurp_communication_write_end();
+    pending.len = 0;
+    rurp_communication_flush();
+}
+#endif
+
+void op_discard_input() {
+#ifdef DOUBLE_BUFFERING
+    ahead.state = AHEAD_IDLE;
+#endif
+    rurp_communication_drain(DRAIN_QUIET_MS);
+}
+
 void set_operation_to_done(firestarter_handle_t* handle) {
     log_info_const("Main done");
+    _log_throughput(handle);
     set_operation_state_done();
     send_main_done();
 }
@@ -210,12 +428,17 @@ static inline int _execute_operation_house_keeping(firestarter_handle_t* handle)
     }
     // log_info_format("Can operation start: %d", can_operation_start(OPERATION));
     if (can_operation_start(MAIN)) {
-        if (!op_wait_for_ack(handle)) {
+        if (!is_auto_advance() && !op_wait_for_ack_timeout(handle, ACK_TIMEOUT_MAIN_MS)) {
             return ERROR;
         }
         op_reset_timeout();
         set_operation_state(MAIN);
         log_info_const("Main start");
+        main_start_ms = millis();
+        main_start_address = handle->address;
+#ifdef DOUBLE_BUFFERING
+        ahead.state = AHEAD_IDLE;
+#endif
         return CONTINUE;
     }
     int res = _execute_operation_house_keeping_func(handle->firestarter_operation_init, INIT, handle);
@@ -243,7 +466,7 @@ static inline int _execute_operation_house_keeping_func(void (*callback)(firesta
         // log_info_format("%s function, state: %d, can start: %d", name, state, can_operation_start(state));
         if (can_operation_start(state)) {
             // log_info_format("Waiting for ACK to start %s phase", name);
-            if (!op_wait_for_ack(handle)) {
+            if (!is_auto_advance() && !op_wait_for_ack_timeout(handle, state == INIT ? ACK_TIMEOUT_INIT_MS : ACK_TIMEOUT_END_MS)) {
                 return ERROR;
             }
             if (state == INIT) {
@@ -265,6 +488,12 @@ static inline int _execute_operation_house_keeping_func(void (*callback)(firesta
         if (state == INIT) {
             send_init_done();
         } else {
+            if (ack_stats.count > 0) {
+                log_info_format("Ack wait: %u, avg %lu us, max %lu us", ack_stats.count, ack_stats.total_us / ack_stats.count, ack_stats.max_us);
+            }
+            const rurp_rx_stats_t* rx_stats = rurp_communication_rx_stats();
+            log_info_format("Rx drops: %u ring, %u overrun, %u framing", rx_stats->ring_overflows, rx_stats->hw_overruns, rx_stats->frame_errors);
+            op_reset_bus();
             send_end_done();
         }
         set_operation_state_done();
@@ -272,6 +501,22 @@ static inline int _execute_operation_house_keeping_func(void (*callback)(firesta
     return CONTINUE;
 }
 
+/**
+ * @brief Logs the transfer rate of the MAIN phase.
+ *
+ * Only operations that advance the address (read, write, verify) are reported,
+ * together with the chunk size so different sizes can be compared.
+ *
+ * @param handle Pointer to the firestarter handle.
+ */
+static inline void _log_throughput(firestarter_handle_t* handle) {
+    uint32_t bytes = handle->address - main_start_address;
+    unsigned long ms = millis() - main_start_ms;
+    if (bytes > 0 && ms > 0) {
+        log_info_format("%lu B in %lu ms, %lu B/s, chunk: %u", bytes, ms, bytes * 1000 / ms, handle->chunk_size);
+    }
+}
+
 /**
  * @brief A callback for simple operations that completes in one step.
  *
@@ -329,7 +574,7 @@ static inline bool _check_response(firestarter_handle_t* handle) {
             break;
         case RESPONSE_CODE_DATA:
             log_data(handle->response_msg);
-            rurp_communication_write(handle->data_buffer, handle->data_size);
+            rurp_communication_write(handle->data_buffer, handle->data_size, 0);
             break;
         case RESPONSE_CODE_ERROR:
         default:
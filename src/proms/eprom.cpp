@@ -81,6 +81,17 @@ void eprom_erase_execute(firestarter_handle_t* handle) {
 }
 
 void eprom_write_init(firestarter_handle_t* handle) {
+    if (is_flag_set(FLAG_RESUME)) {
+        // The chip is partly programmed, erase and blank check would undo or fail on that
+        if (!is_operation_in_progress(handle)) {
+            eprom_generic_init(handle);
+            if (handle->response_code == RESPONSE_CODE_ERROR) {
+                return;
+            }
+        }
+        mem_util_resume_check(handle);
+        return;
+    }
     if(!is_operation_in_progress(handle)){
         eprom_generic_init(handle);
         if (handle->response_code == RESPONSE_CODE_ERROR) {
@@ -110,6 +121,7 @@ static void program_mismatched_bytes(firestarter_handle_t* handle, const uint8_t
         // Use the corrected bitwise-AND operator here
         if (mismatch_bitmask[i / 8] & (1 << (i % 8))) {
             handle->firestarter_set_data(handle, handle->address + i, handle->data_buffer[i]);
+            op_service_link(handle);
         }
     }
     handle->firestarter_set_control_register(handle, programming_bits, 0);
@@ -125,6 +137,9 @@ static int verify_and_update_mask(firestarter_handle_t* handle, uint8_t* mismatc
         } else {
             mismatch_bitmask[i / 8] &= ~(1 << (i % 8)); // Clear bit for match
         }
+        if ((i & 0x1F) == 0) {
+            op_service_link(handle);
+        }
     }
     
     return mismatch_count;
@@ -12,6 +12,7 @@
 #include "flash_utils.h"
 #include "firestarter.h"
 #include "logging.h"
+#include "operation_utils.h"
 
 void flash3_erase_execute(firestarter_handle_t* handle);
 void flash3_write_init(firestarter_handle_t* handle);
@@ -56,14 +57,23 @@ void flash3_generic_init(firestarter_handle_t* handle) {
 
 
 void flash3_write_init(firestarter_handle_t* handle) {
-    if (handle->chip_id > 0) {
-        flash3_check_chip_id_execute(handle);
-        if (handle->response_code == RESPONSE_CODE_ERROR) {
-            return;
+    // The blank check runs in steps, the chip ID check and erase only on the first one
+    if (!is_operation_in_progress(handle)) {
+        if (handle->chip_id > 0) {
+            flash3_check_chip_id_execute(handle);
+            if (handle->response_code == RESPONSE_CODE_ERROR) {
+                return;
+            }
         }
     }
 
-    if (is_flag_set(FLAG_CAN_ERASE)) {
+    if (is_flag_set(FLAG_RESUME)) {
+        // The chip is partly programmed, erase and blank check would undo or fail on that
+        mem_util_resume_check(handle);
+        return;
+    }
+
+    if (is_flag_set(FLAG_CAN_ERASE) && !is_operation_in_progress(handle)) {
         if (!is_flag_set(FLAG_SKIP_ERASE)) {
             flash3_erase_execute(handle);
             delay(FLASH_ERASE_DELAY_MS); 
@@ -87,6 +97,7 @@ void flash3_write_execute(firestarter_handle_t* handle) {
         if (handle->response_code == RESPONSE_CODE_ERROR) {
             return;
         }
+        op_service_link(handle);
     }
 }
 
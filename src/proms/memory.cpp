@@ -9,20 +9,18 @@
 
 #include <Arduino.h>
 #include <stdint.h>
+#include <util/delay_basic.h>
 
+#include "crc16.h"
 #include "eprom.h"
 #include "flash_type_3.h"
 #include "logging.h"
 #include "memory_utils.h"
 #include "operation_utils.h"
+#include "rurp_board_io.h"
 #include "rurp_shield.h"
 #include "sram.h"
 
-#define TYPE_EPROM 1
-#define TYPE_FLASH_TYPE_2 2
-#define TYPE_FLASH_TYPE_3 3
-#define TYPE_SRAM 4
-
 #ifndef min
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #endif
@@ -30,6 +28,7 @@
 void memory_read_execute(firestarter_handle_t* handle);
 void memory_write_execute(firestarter_handle_t* handle);
 void memory_verify_execute(firestarter_handle_t* handle);
+void memory_calibrate_execute(firestarter_handle_t* handle);
 
 void memory_set_control_register(firestarter_handle_t* handle, rurp_register_t bit, bool state);
 bool memory_get_control_register(firestarter_handle_t* handle, rurp_register_t bit);
@@ -38,6 +37,19 @@ void memory_set_data(firestarter_handle_t* handle, uint32_t address, uint8_t dat
 
 uint8_t programming = 0;
 
+// Iterations of _delay_loop_2 (4 cycles each) for the access time, set by configure_memory
+static uint16_t access_loops = 0;
+
+static uint16_t _access_loops(uint32_t access_ns) {
+    return (access_ns * (F_CPU / 1000000UL) + 3999) / 4000;
+}
+
+static inline void _delay_access() {
+    if (access_loops > 0) {
+        _delay_loop_2(access_loops);
+    }
+}
+
 void configure_memory(firestarter_handle_t* handle) {
     debug("Configuring memory");
     handle->firestarter_operation_init = NULL;
@@ -54,6 +66,9 @@ void configure_memory(firestarter_handle_t* handle) {
         case CMD_VERIFY:
             handle->firestarter_operation_main = memory_verify_execute;
             break;
+        case CMD_CALIBRATE:
+            handle->firestarter_operation_main = memory_calibrate_execute;
+            break;
     }
 
     handle->firestarter_get_data = memory_get_data;
@@ -64,6 +79,8 @@ void configure_memory(firestarter_handle_t* handle) {
     handle->firestarter_set_control_register = memory_set_control_register;
     handle->firestarter_get_control_register = memory_get_control_register;
 
+    mem_util_prepare_remap(handle);
+    access_loops = _access_loops(handle->access_ns > 0 ? handle->access_ns : ACCESS_NS_DEFAULT);
     mem_util_set_address(handle, 0);
 
     if (handle->mem_type == TYPE_EPROM) {
@@ -135,13 +152,66 @@ void mem_util_set_address(firestarter_handle_t* handle, uint32_t address) {
 #endif
 }
 
+// Set by mem_util_prepare_remap when the low 8 lines go straight to the LSB latch
+static bool burst_linear;
+// Next address of the burst, in linear mode the start of the next 256 bytes
+static uint32_t burst_address;
+// Low byte of the next address in linear mode, 0 sets the whole address
+static uint8_t burst_lsb;
+// Remapped address bits above the LSB latch of the last burst read
+static uint32_t burst_upper;
+
+bool mem_util_burst_begin(firestarter_handle_t* handle, uint32_t address) {
+    if (handle->firestarter_get_data != memory_get_data) {
+        return false;  // The memory reads its own way
+    }
+    burst_address = address;
+    burst_lsb = 0;
+    burst_upper = 0xFFFFFFFF;
+    rurp_chip_output();
+    return true;
+}
+
+uint8_t mem_util_burst_read(firestarter_handle_t* handle) {
+    if (burst_linear) {
+        if (burst_lsb == 0) {
+            // First read or rolled over, the upper bits are remapped once per 256 bytes
+            mem_util_set_address(handle, mem_util_remap_address_bus(handle, burst_address, READ_FLAG));
+            burst_lsb = burst_address;
+            burst_address = (burst_address | 0xFF) + 1;
+        } else {
+            rurp_io_write_lsb(burst_lsb);
+        }
+        burst_lsb++;
+    } else {
+        uint32_t address = mem_util_remap_address_bus(handle, burst_address++, READ_FLAG);
+        if ((address >> 8) != burst_upper) {
+            burst_upper = address >> 8;
+            mem_util_set_address(handle, address);
+        } else {
+            rurp_io_write_lsb((uint8_t)address);
+        }
+    }
+    rurp_io_set_data_input();
+    rurp_io_chip_enable();
+    _delay_access();
+    uint8_t data = rurp_io_read_data();
+    rurp_io_chip_disable();
+    return data;
+}
+
 void memory_read_execute(firestarter_handle_t* handle) {
-    int buf_size = min(handle->mem_size - handle->address, DATA_BUFFER_SIZE);
+    int buf_size = min(handle->mem_size - handle->address, handle->chunk_size);
     debug_format("Reading from address 0x%06x", handle->address);
+    bool burst = mem_util_burst_begin(handle, handle->address);
     for (int i = 0; i < buf_size; i++) {
-        uint8_t data = handle->firestarter_get_data(handle, handle->address + i);
+        uint32_t address = handle->address + i;
+        uint8_t data = burst ? mem_util_burst_read(handle) : handle->firestarter_get_data(handle, address);
         // debug_format("Data 0x%02x %c", data, data);
         handle->data_buffer[i] = data;
+        if ((i & 0x1F) == 0) {
+            op_service_link(handle);
+        }
     }
     handle->data_size = buf_size;
 }
@@ -151,11 +221,11 @@ uint8_t memory_get_data(firestarter_handle_t* handle, uint32_t address) {
     address = mem_util_remap_address_bus(handle, address, READ_FLAG);
 
     handle->firestarter_set_address(handle, address);
-    rurp_set_data_input();
-    rurp_chip_enable();
-    delayMicroseconds(3);
-    uint8_t data = rurp_read_data_buffer();
-    rurp_chip_disable();
+    rurp_io_set_data_input();
+    rurp_io_chip_enable();
+    _delay_access();
+    uint8_t data = rurp_io_read_data();
+    rurp_io_chip_disable();
 
     return data;
 }
@@ -163,6 +233,7 @@ uint8_t memory_get_data(firestarter_handle_t* handle, uint32_t address) {
 void memory_write_execute(firestarter_handle_t* handle) {
     for (uint32_t i = 0; i < handle->data_size; i++) {
         handle->firestarter_set_data(handle, handle->address + i, handle->data_buffer[i]);
+        op_service_link(handle);
     }
 }
 
@@ -171,44 +242,130 @@ void memory_set_data(firestarter_handle_t* handle, uint32_t address, uint8_t dat
     address = mem_util_remap_address_bus(handle, address, WRITE_FLAG);
 
     handle->firestarter_set_address(handle, address);
-    rurp_write_data_buffer(data);
+    rurp_io_write_data(data);
     delayMicroseconds(3);  // Needed for slower address changes like slow ROMs and "Power through address lines"
-    rurp_chip_enable();
+    rurp_io_chip_enable();
     delayMicroseconds(handle->pulse_delay);
-    rurp_chip_disable();
+    rurp_io_chip_disable();
 }
 
 void memory_verify_execute(firestarter_handle_t* handle) {
+    bool burst = mem_util_burst_begin(handle, handle->address);
     for (uint32_t i = 0; i < handle->data_size; i++) {
-        uint8_t byte = handle->firestarter_get_data(handle, handle->address + i);
+        uint32_t address = handle->address + i;
+        uint8_t byte = burst ? mem_util_burst_read(handle) : handle->firestarter_get_data(handle, address);
         uint8_t expected = handle->data_buffer[i];
         if (byte != expected) {
             firestarter_error_response_format("0x%02x != 0x%02x at 0x%06x", expected, byte, handle->address + i);
             return;
         }
+        if ((i & 0x1F) == 0) {
+            op_service_link(handle);
+        }
     }
 }
 
-// Utility functions
-uint32_t mem_util_remap_address_bus(const firestarter_handle_t* handle, uint32_t address, uint8_t read_write) {
-    bus_config_t config = handle->bus_config;
-    uint32_t reorg_address = config.address_mask & address;
-    if (config.address_lines[0] != 0xFF) {
-        for (int i = config.matching_lines; i < ADDRESS_LINES_SIZE && config.address_lines[i] != 0xFF; i++) {
-            uint32_t line_bit = (uint32_t)1 << config.address_lines[i];
-            reorg_address &= ~line_bit;
-            if (address & 1UL << i) {
-                reorg_address |= line_bit;
-            }
+static bool _sample_matches(firestarter_handle_t* handle, const char* reference, uint16_t size) {
+    bool burst = mem_util_burst_begin(handle, handle->address);
+    for (uint16_t i = 0; i < size; i++) {
+        uint32_t address = handle->address + i;
+        uint8_t data = burst ? mem_util_burst_read(handle) : handle->firestarter_get_data(handle, address);
+        if (data != (uint8_t)reference[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads a sample from "address" at ACCESS_NS_DEFAULT as reference, then at shorter access
+// times until a read differs. The shortest stable time plus a margin is reported.
+void memory_calibrate_execute(firestarter_handle_t* handle) {
+    if (handle->address >= handle->mem_size) {
+        firestarter_error_response("No sample at address");
+        return;
+    }
+    uint16_t size = min(handle->mem_size - handle->address, DATA_BUFFER_SIZE);
+    uint16_t configured = access_loops;
+    access_loops = _access_loops(ACCESS_NS_DEFAULT);
+    bool burst = mem_util_burst_begin(handle, handle->address);
+    for (uint16_t i = 0; i < size; i++) {
+        uint32_t address = handle->address + i;
+        handle->data_buffer[i] = burst ? mem_util_burst_read(handle) : handle->firestarter_get_data(handle, address);
+    }
+    if (!_sample_matches(handle, handle->data_buffer, size)) {
+        access_loops = configured;
+        firestarter_error_response_format("Unstable at %u ns", ACCESS_NS_DEFAULT);
+        return;
+    }
+
+    uint16_t stable = access_loops;
+    while (access_loops > 0) {
+        access_loops--;
+        bool matches = true;
+        for (uint8_t pass = 0; pass < CALIBRATE_PASSES && matches; pass++) {
+            matches = _sample_matches(handle, handle->data_buffer, size);
+        }
+        if (!matches) {
+            break;
         }
+        stable = access_loops;
     }
-    if (config.rw_line != 0xFF) {
-        reorg_address |= (uint32_t)read_write << config.rw_line;
+    access_loops = configured;
+
+    uint16_t stable_ns = stable * 4000UL / (F_CPU / 1000000UL);
+    // A data line, the result is wanted without FLAG_VERBOSE
+    log_data_format("Access: %u ns, stable: %u ns", stable_ns + CALIBRATE_MARGIN_NS, stable_ns);
+}
+
+// Utility functions
+// Address bus remapping, compiled from the bus config by mem_util_prepare_remap
+static struct {
+    uint32_t identity_mask;                 // Lines that keep their position
+    uint32_t or_mask[2];                    // RW and VPP lines, indexed by WRITE_FLAG/READ_FLAG
+    uint32_t first_source;                  // Bit of the first remapped line in the address
+    uint8_t first_line;                     // First remapped line
+    uint8_t end_line;                       // One past the last remapped line
+    uint32_t line_bit[ADDRESS_LINES_SIZE];  // Bit each remapped line is moved to
+} remap;
+
+void mem_util_prepare_remap(const firestarter_handle_t* handle) {
+    const bus_config_t* config = &handle->bus_config;
+    remap.identity_mask = config->address_mask;
+    remap.first_line = 0;
+    remap.end_line = 0;
+    if (config->address_lines[0] != 0xFF) {
+        remap.first_line = min(config->matching_lines, ADDRESS_LINES_SIZE);
+        remap.end_line = remap.first_line;
+        while (remap.end_line < ADDRESS_LINES_SIZE && config->address_lines[remap.end_line] != 0xFF) {
+            uint32_t line_bit = 1UL << config->address_lines[remap.end_line];
+            remap.identity_mask &= ~line_bit;
+            remap.line_bit[remap.end_line++] = line_bit;
+        }
     }
+    remap.first_source = 1UL << remap.first_line;
 
+    uint32_t or_mask = 0;
     // Set VPP line to high if VPP is not on P1
-    if (config.vpp_line != 0xFF && !using_p1_as_vpp(handle)) {
-        reorg_address |= 1UL << config.vpp_line;
+    if (config->vpp_line != 0xFF && !using_p1_as_vpp(handle)) {
+        or_mask |= 1UL << config->vpp_line;
+    }
+    remap.or_mask[WRITE_FLAG] = or_mask;
+    if (config->rw_line != 0xFF) {
+        or_mask |= 1UL << config->rw_line;
+    }
+    remap.or_mask[READ_FLAG] = or_mask;
+
+    burst_linear = (remap.identity_mask & 0xFF) == 0xFF && (or_mask & 0xFF) == 0 &&
+                   (remap.first_line >= 8 || remap.first_line == remap.end_line);
+}
+
+uint32_t mem_util_remap_address_bus(const firestarter_handle_t* handle, uint32_t address, uint8_t read_write) {
+    uint32_t reorg_address = (address & remap.identity_mask) | remap.or_mask[read_write];
+    uint32_t source = remap.first_source;
+    for (uint8_t i = remap.first_line; i < remap.end_line; i++, source <<= 1) {
+        if (address & source) {
+            reorg_address |= remap.line_bit[i];
+        }
     }
     return reorg_address;
 }
@@ -217,7 +374,11 @@ typedef struct {
     uint32_t address;
 } blank_check_progress_data_t;
 
-#define BLANK_CHECK_CHUNK_SIZE 2048
+typedef struct {
+    uint32_t address;
+    uint16_t crc;
+} resume_check_progress_data_t;
+
 void uint32_to_bytes(char* buffer, int pos, uint32_t value) {
     buffer[pos] = (value >> 24) & 0xFF;
     buffer[pos++] = (value >> 16) & 0xFF;
@@ -244,16 +405,22 @@ void mem_util_blank_check(firestarter_handle_t* handle) {
         }
     }
 
-    // for (uint32_t i = handle->address; i < handle->address + BLANK_CHECK_CHUNK_SIZE; i++) {
-    uint32_t end_address = handle->address + BLANK_CHECK_CHUNK_SIZE;
+    // The negotiated chunk is only for the blank check command, erase and write keep the default step
+    uint16_t step = handle->cmd == CMD_BLANK_CHECK ? handle->chunk_size : BLANK_CHECK_CHUNK_SIZE;
+    uint32_t end_address = handle->address + step;
+    bool burst = mem_util_burst_begin(handle, handle->address);
     for (uint32_t i = handle->address; i < end_address && i < handle->mem_size; i++) {
-        uint8_t val = handle->firestarter_get_data(handle, i);
+        if ((i & 0xFF) == 0 && op_check_abort(handle)) {
+            handle->address = i;
+            return;
+        }
+        uint8_t val = burst ? mem_util_burst_read(handle) : handle->firestarter_get_data(handle, i);
         if (val != 0xFF) {
             firestarter_error_response_format("Not blank, at 0x%06x, v: 0x%02x", i, val);
             return;
         }
     }
-    handle->address += BLANK_CHECK_CHUNK_SIZE;
+    handle->address += handle->chunk_size;
 // #define RAW_DATA_PROGRESS
 #ifdef RAW_DATA_PROGRESS
     handle->response_code = RESPONSE_CODE_DATA;
@@ -268,3 +435,46 @@ void mem_util_blank_check(firestarter_handle_t* handle) {
     firestarter_data_response_format("%lu/%lu", handle->address, handle->mem_size);
 #endif
 }
+
+// Confirms the part of the chip below the resume address against the host's CRC-16.
+// Runs in steps of BLANK_CHECK_CHUNK_SIZE with progress like the blank check.
+void mem_util_resume_check(firestarter_handle_t* handle) {
+    resume_check_progress_data_t* progress_data;
+    if (!is_operation_in_progress(handle)) {
+        set_operation_in_progress(handle);
+        handle->progress_data = malloc(sizeof(resume_check_progress_data_t));
+        progress_data = (resume_check_progress_data_t*)handle->progress_data;
+        progress_data->address = handle->address;
+        progress_data->crc = CRC16_INIT;
+        handle->address = 0;
+    } else {
+        progress_data = (resume_check_progress_data_t*)handle->progress_data;
+    }
+
+    uint32_t end_address = min(handle->address + BLANK_CHECK_CHUNK_SIZE, progress_data->address);
+    bool burst = mem_util_burst_begin(handle, handle->address);
+    for (uint32_t i = handle->address; i < end_address; i++) {
+        if ((i & 0xFF) == 0 && op_check_abort(handle)) {
+            handle->address = i;
+            return;
+        }
+        uint8_t val = burst ? mem_util_burst_read(handle) : handle->firestarter_get_data(handle, i);
+        progress_data->crc = crc16_update(progress_data->crc, &val, 1);
+    }
+    handle->address = end_address;
+
+    if (handle->address < progress_data->address) {
+        firestarter_data_response_format("%lu/%lu", handle->address, progress_data->address);
+        return;
+    }
+
+    uint16_t crc = progress_data->crc;
+    clear_operation_in_progress(handle);
+    free(handle->progress_data);
+    handle->progress_data = NULL;
+    if (crc != handle->resume_crc) {
+        firestarter_error_response_format("Resume CRC 0x%04x, expected 0x%04x", crc, handle->resume_crc);
+        return;
+    }
+    firestarter_response_format(RESPONSE_CODE_OK, "Resume at 0x%06lx", handle->address);
+}